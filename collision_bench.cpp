@@ -0,0 +1,320 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "collision_grid.h"
+
+// Compares the game's collision query against CollisionGrid on generated maps of 10k and
+// 1M tiles. The linear scan is the old MyGame::CheckCollision loop over every wall and
+// cypher position, minus the registry lookup per entity, so it is a lower bound for
+// what the game paid before. Spawning compares the old RandomWalkablePosition, which
+// collected the walkable tiles on every call, with PickWalkable. Merging counts how
+// many wall objects the game creates, one per merged box instead of one per tile.
+// Sweeps measure MoveCircle and check the moves that used to tunnel or stop dead.
+// Builds without the engine:
+//
+//   g++ -std=c++17 -O2 collision_bench.cpp -o collision_bench
+
+static constexpr float PLAYER_RADIUS = 0.3f;
+static constexpr float WALL_HALF_EXTENT = 0.5f;
+static constexpr float CYPHER_HALF_EXTENT = 0.05f;
+static volatile int benchSink = 0;
+
+// xorshift64*, the same maps on every platform
+class BenchRandom {
+public:
+    explicit BenchRandom(uint64_t seed) : state(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+
+    float uniform() { return (next() >> 40) * (1.0f / 16777216.0f); }
+
+private:
+    uint64_t state;
+};
+
+struct Box {
+    float x, y, halfExtent;
+};
+
+// A bordered map with `wallShare` of the inner tiles as walls
+std::vector<std::string> makeMap(int size, float wallShare, BenchRandom& random) {
+    std::vector<std::string> rows(size, std::string(size, '.'));
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            bool border = row == 0 || col == 0 || row == size - 1 || col == size - 1;
+            if (border || random.uniform() < wallShare) rows[row][col] = '#';
+        }
+    }
+    return rows;
+}
+
+bool linearOverlaps(const std::vector<Box>& boxes, float x, float y) {
+    for (auto& box : boxes) {
+        if (CollisionGrid::CircleOverlapsBox(x, y, PLAYER_RADIUS, box.x, box.y, box.halfExtent)) return true;
+    }
+    return false;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runMap(int size, int cyphers, uint64_t seed) {
+    BenchRandom random(seed);
+    auto rows = makeMap(size, 0.3f, random);
+
+    auto buildStart = std::chrono::steady_clock::now();
+    CollisionGrid grid;
+    grid.Build(rows);
+    double buildMs = secondsSince(buildStart) * 1000.0;
+
+    std::vector<Box> boxes;
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            if (rows[row][col] != '#') continue;
+            float x, y;
+            grid.TileCenter(col, row, x, y);
+            boxes.push_back(Box{ x, y, WALL_HALF_EXTENT });
+        }
+    }
+    size_t walls = boxes.size();
+
+    float minX, minY, maxX, maxY;
+    grid.TileCenter(0, 0, minX, minY);
+    grid.TileCenter(size - 1, size - 1, maxX, maxY);
+    auto randomPoint = [&](float& x, float& y) {
+        x = minX + random.uniform() * (maxX - minX);
+        y = minY + random.uniform() * (maxY - minY);
+    };
+    for (int i = 0; i < cyphers; ++i) {
+        float x, y;
+        randomPoint(x, y);
+        boxes.push_back(Box{ x, y, CYPHER_HALF_EXTENT });
+        grid.AddBody(x, y, CYPHER_HALF_EXTENT);
+    }
+
+    // the scan costs walls x queries, keep it around 1e8 box tests
+    int gridQueries = 1000000;
+    int linearQueries = static_cast<int>(std::max<size_t>(100, 100000000 / boxes.size()));
+    std::vector<float> points(2 * size_t(gridQueries));
+    for (int i = 0; i < gridQueries; ++i) randomPoint(points[2 * i], points[2 * i + 1]);
+
+    int mismatches = 0;
+    int linearHits = 0;
+    auto linearStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < linearQueries; ++i) linearHits += linearOverlaps(boxes, points[2 * i], points[2 * i + 1]);
+    double linearNs = secondsSince(linearStart) * 1e9 / linearQueries;
+
+    int gridHits = 0;
+    auto gridStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < gridQueries; ++i) gridHits += grid.OverlapsCircle(points[2 * i], points[2 * i + 1], PLAYER_RADIUS);
+    double gridNs = secondsSince(gridStart) * 1e9 / gridQueries;
+
+    for (int i = 0; i < linearQueries; ++i) {
+        float x = points[2 * i], y = points[2 * i + 1];
+        if (linearOverlaps(boxes, x, y) != grid.OverlapsCircle(x, y, PLAYER_RADIUS)) mismatches++;
+    }
+
+    printf("%4dx%-4d %8zu walls %5d cyphers | build %8.2f ms | linear %12.0f ns/query | grid %6.1f ns/query | %6.0fx | hits %.1f%% | mismatches %d\n",
+           size, size, walls, cyphers, buildMs, linearNs, gridNs, linearNs / gridNs,
+           100.0 * gridHits / gridQueries, mismatches);
+    benchSink = linearHits; // keeps the timed scan from being optimised away
+}
+
+// The old RandomWalkablePosition: every call scans the whole map
+bool rescanWalkable(const std::vector<std::string>& rows, BenchRandom& random, int& col, int& row) {
+    std::vector<std::pair<int, int>> walkableTiles;
+    for (int r = 0; r < (int)rows.size(); ++r) {
+        for (int c = 0; c < (int)rows[r].size(); ++c) {
+            if (rows[r][c] != '#') walkableTiles.emplace_back(r, c);
+        }
+    }
+    if (walkableTiles.empty()) return false;
+    std::tie(row, col) = walkableTiles[random.next() % walkableTiles.size()];
+    return true;
+}
+
+void runSpawns(int size, int spawns, uint64_t seed) {
+    BenchRandom random(seed);
+    auto rows = makeMap(size, 0.3f, random);
+    CollisionGrid grid;
+    grid.Build(rows);
+
+    // a few are enough, each one costs a full map scan
+    int rescans = std::min(spawns, 20);
+    int col = 0, row = 0;
+    auto rescanStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < rescans; ++i) rescanWalkable(rows, random, col, row);
+    double rescanNs = secondsSince(rescanStart) * 1e9 / rescans;
+    benchSink = col + row;
+
+    auto next = [&]() { return random.next(); };
+    int constrained = 0;
+    auto pickStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < spawns; ++i) {
+        float x = 0.0f, y = 0.0f;
+        grid.PickWalkable(next, 0.0f, 0.0f, 2.0f, 1.5f, x, y);
+        if (!grid.AnyBodyWithin(x, y, 1.5f)) constrained++;
+        grid.AddBody(x, y, CYPHER_HALF_EXTENT);
+    }
+    double pickNs = secondsSince(pickStart) * 1e9 / spawns;
+
+    // walls added and removed again must give back the same walkable set
+    size_t walkable = grid.GetWalkableCount();
+    for (int i = 1; i < size - 1; ++i) grid.SetWall(i, size / 2, true);
+    for (int i = 1; i < size - 1; ++i) grid.SetWall(i, size / 2, rows[size / 2][i] == '#');
+
+    printf("%4dx%-4d %8zu walkable %6d spawns | rescan %12.0f ns/spawn | index %6.1f ns/spawn | %6.0fx | spaced %.1f%% | edits %s\n",
+           size, size, walkable, spawns, rescanNs, pickNs, rescanNs / pickNs, 100.0 * constrained / spawns,
+           grid.GetWalkableCount() == walkable ? "ok" : "MISMATCH");
+}
+
+// Rooms of `room` tiles with a door in every wall, like a hand-made level
+std::vector<std::string> makeRooms(int size, int room) {
+    std::vector<std::string> rows(size, std::string(size, '.'));
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            bool wallRow = row % room == 0 || row == size - 1;
+            bool wallCol = col % room == 0 || col == size - 1;
+            bool door = (wallRow && col % room == room / 2) || (wallCol && row % room == room / 2);
+            if ((wallRow || wallCol) && !door) rows[row][col] = '#';
+        }
+    }
+    return rows;
+}
+
+void runMerge(const char* name, const std::vector<std::string>& rows) {
+    CollisionGrid grid;
+    grid.Build(rows);
+    auto mergeStart = std::chrono::steady_clock::now();
+    auto boxes = grid.MergeWalls();
+    double mergeMs = secondsSince(mergeStart) * 1000.0;
+
+    // every wall tile in exactly one box, no floor in any
+    std::vector<int> cover(size_t(grid.GetColumns()) * grid.GetRows(), 0);
+    for (auto& box : boxes) {
+        for (int row = box.row; row < box.row + box.rows; ++row) {
+            for (int col = box.col; col < box.col + box.columns; ++col) cover[size_t(row) * grid.GetColumns() + col]++;
+        }
+    }
+    size_t walls = 0;
+    bool exact = true;
+    for (int row = 0; row < grid.GetRows(); ++row) {
+        for (int col = 0; col < grid.GetColumns(); ++col) {
+            bool wall = grid.IsWall(col, row);
+            walls += wall;
+            if (cover[size_t(row) * grid.GetColumns() + col] != (wall ? 1 : 0)) exact = false;
+        }
+    }
+
+    printf("%-18s %4dx%-4d %8zu wall objects -> %7zu merged (%5.1f%%) | merge %8.2f ms | cover %s\n", name,
+           grid.GetColumns(), grid.GetRows(), walls, boxes.size(), 100.0 * boxes.size() / std::max<size_t>(walls, 1),
+           mergeMs, exact ? "ok" : "WRONG");
+}
+
+// A single move on a small map, printed as a check
+void checkMove(const char* name, const std::vector<std::string>& rows, float cypherX, float cypherY,
+               float x, float y, float dx, float dy, bool (*expect)(float x, float y)) {
+    CollisionGrid grid;
+    grid.Build(rows, '#', 0, 0, 1.0f);
+    if (cypherX != 0.0f || cypherY != 0.0f) grid.AddBody(cypherX, cypherY, CYPHER_HALF_EXTENT);
+
+    // what the game did before: the end position only
+    bool endOnlyPasses = !grid.OverlapsCircle(x + dx, y + dy, PLAYER_RADIUS);
+    bool hit = grid.MoveCircle(x, y, dx, dy, PLAYER_RADIUS);
+    bool ok = expect(x, y) && !grid.OverlapsCircle(x, y, PLAYER_RADIUS);
+    printf("  %-34s end-only check %-8s | swept: hit %d, ends at %6.3f,%6.3f %s\n", name,
+           endOnlyPasses ? "moves" : "blocks", hit, x, y, ok ? "ok" : "WRONG");
+}
+
+void runSweeps(int size, uint64_t seed) {
+    BenchRandom random(seed);
+    auto rows = makeMap(size, 0.3f, random);
+    CollisionGrid grid;
+    grid.Build(rows);
+    float minX, minY, maxX, maxY;
+    grid.TileCenter(0, 0, minX, minY);
+    grid.TileCenter(size - 1, size - 1, maxX, maxY);
+    for (int i = 0; i < size * size / 100; ++i) {
+        grid.AddBody(minX + random.uniform() * (maxX - minX), minY + random.uniform() * (maxY - minY), CYPHER_HALF_EXTENT);
+    }
+
+    // free starting points and moves up to two tiles long, like a frame at a low rate
+    const int moves = 200000;
+    std::vector<float> starts, deltas;
+    while ((int)starts.size() < 2 * moves) {
+        float x = minX + random.uniform() * (maxX - minX), y = minY + random.uniform() * (maxY - minY);
+        if (grid.OverlapsCircle(x, y, PLAYER_RADIUS)) continue;
+        starts.push_back(x);
+        starts.push_back(y);
+        deltas.push_back((random.uniform() - 0.5f) * 4.0f);
+        deltas.push_back((random.uniform() - 0.5f) * 4.0f);
+    }
+
+    int endOnlyHits = 0;
+    auto endStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < moves; ++i) {
+        endOnlyHits += grid.OverlapsCircle(starts[2 * i] + deltas[2 * i], starts[2 * i + 1] + deltas[2 * i + 1], PLAYER_RADIUS);
+    }
+    double endSeconds = secondsSince(endStart);
+    benchSink = endOnlyHits;
+
+    int hits = 0, overlapping = 0;
+    std::vector<float> ends(starts);
+    auto sweepStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < moves; ++i) hits += grid.MoveCircle(ends[2 * i], ends[2 * i + 1], deltas[2 * i], deltas[2 * i + 1], PLAYER_RADIUS);
+    double sweepSeconds = secondsSince(sweepStart);
+    // touching within float rounding is fine, far from the origin that is a few 1e-5
+    for (int i = 0; i < moves; ++i) overlapping += grid.OverlapsCircle(ends[2 * i], ends[2 * i + 1], PLAYER_RADIUS - 1e-3f);
+
+    printf("%4dx%-4d sweeps | end-only %6.2f M queries/s | swept %6.2f M moves/s | hit %.1f%% | ended >1mm inside %d\n",
+           size, size, moves / endSeconds / 1e6, moves / sweepSeconds / 1e6, 100.0 * hits / moves, overlapping);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1;
+    runMap(100, 3, seed);
+    runMap(100, 1000, seed);
+    runMap(1000, 3, seed);
+    runMap(1000, 10000, seed);
+    runSpawns(100, 1000, seed);
+    runSpawns(1000, 10000, seed);
+
+    runSweeps(100, seed);
+    runSweeps(1000, seed);
+
+    // tiles are centred on whole numbers, walls span +-0.5 around them
+    std::vector<std::string> open(9, "........."), wall = open, corner = open;
+    for (auto& row : wall) row[4] = '#';
+    for (int i = 4; i < 9; ++i) corner[4][i] = corner[i][4] = '#';
+    checkMove("thin cypher, 4 tile step", open, 4.0f, 2.0f, 1.0f, 2.0f, 4.0f, 0.0f,
+              [](float x, float) { return x < 4.0f - CYPHER_HALF_EXTENT - PLAYER_RADIUS + 0.01f; });
+    checkMove("wall, 3 tile step", wall, 0.0f, 0.0f, 2.0f, 2.0f, 3.0f, 0.0f,
+              [](float x, float) { return x < 3.5f - PLAYER_RADIUS + 0.01f; });
+    checkMove("diagonal into wall slides", wall, 0.0f, 0.0f, 3.0f, 2.0f, 0.5f, 0.5f,
+              [](float x, float y) { return x > 3.1f && y > 2.45f; });
+    checkMove("diagonal into corner", corner, 0.0f, 0.0f, 2.0f, 2.0f, 2.0f, 2.0f,
+              [](float x, float y) { return x < 3.5f && y < 3.5f; });
+    checkMove("moving away from contact", wall, 0.0f, 0.0f, 3.2f, 2.0f, -0.5f, 0.0f,
+              [](float x, float) { return x < 2.71f; });
+
+    BenchRandom random(seed);
+    runMerge("random 30%", makeMap(100, 0.3f, random));
+    runMerge("random 30%", makeMap(1000, 0.3f, random));
+    runMerge("rooms 10x10", makeRooms(100, 10));
+    runMerge("rooms 10x10", makeRooms(1000, 10));
+    runMerge("rooms 50x50", makeRooms(1000, 50));
+    return 0;
+}
@@ -0,0 +1,472 @@
+#pragma once
+
+// Collision against the tile maps: walls are answered from the tile layout itself and
+// movable objects are kept in a uniform grid with the same cells, so a query for the
+// player's circle only looks at the few cells its bounds overlap instead of every wall
+// and object in the level. It also keeps the list of walkable tiles for spawning and
+// merges the walls into a few boxes for drawing.
+// No engine types, collision_bench.cpp uses it as it is.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CollisionGrid {
+    public:
+        // Void is outside the level: not a wall, nothing spawns there
+        enum class Tile : uint8_t { Void = 0, Floor = 1, Wall = 2 };
+
+        // Tile (col, row) is centred at ((col - originCol) * spacing, (row - originRow) * spacing),
+        // the layout LoadMapAndSpawnWalls places the wall cubes in
+        void Build(const std::vector<std::string>& rows, char wall = '#', int originCol = 5, int originRow = 1, float spacing = 1.0f) {
+            int columns = 0;
+            for (auto& row : rows) columns = std::max(columns, static_cast<int>(row.size()));
+            // short lines are padded with void
+            Build(columns, static_cast<int>(rows.size()), [&](int col, int row) {
+                if (col >= static_cast<int>(rows[row].size())) return Tile::Void;
+                return rows[row][col] == wall ? Tile::Wall : Tile::Floor;
+            }, originCol, originRow, spacing);
+        }
+
+        // tileAt(col, row) returns the Tile of every position of the map
+        template<typename TileAt>
+        void Build(int columns, int rows, TileAt tileAt, int originCol, int originRow, float spacing) {
+            m_originCol = originCol;
+            m_originRow = originRow;
+            m_spacing = spacing;
+            m_columns = columns;
+            m_rows = rows;
+
+            m_walls.assign(size_t(m_columns) * m_rows, 0);
+            m_walkable.clear();
+            m_walkableSlot.assign(m_walls.size(), NOT_WALKABLE);
+            for (int row = 0; row < m_rows; ++row) {
+                for (int col = 0; col < m_columns; ++col) {
+                    uint32_t tile = uint32_t(row) * m_columns + col;
+                    Tile kind = tileAt(col, row);
+                    if (kind == Tile::Wall) {
+                        m_walls[tile] = 1;
+                    } else if (kind == Tile::Floor) {
+                        m_walkableSlot[tile] = static_cast<uint32_t>(m_walkable.size());
+                        m_walkable.push_back(tile);
+                    }
+                }
+            }
+        }
+
+        bool IsWall(int col, int row) const {
+            if (col < 0 || row < 0 || col >= m_columns || row >= m_rows) return false;
+            return m_walls[size_t(row) * m_columns + col] != 0;
+        }
+
+        // A map edit, keeps the walkable list up to date
+        void SetWall(int col, int row, bool wall) {
+            if (col < 0 || row < 0 || col >= m_columns || row >= m_rows) return;
+            uint32_t tile = uint32_t(row) * m_columns + col;
+            m_walls[tile] = wall ? 1 : 0;
+
+            uint32_t slot = m_walkableSlot[tile];
+            if (wall && slot != NOT_WALKABLE) {
+                uint32_t moved = m_walkable.back();
+                m_walkable[slot] = moved;
+                m_walkableSlot[moved] = slot;
+                m_walkable.pop_back();
+                m_walkableSlot[tile] = NOT_WALKABLE;
+            } else if (!wall && slot == NOT_WALKABLE) {
+                m_walkableSlot[tile] = static_cast<uint32_t>(m_walkable.size());
+                m_walkable.push_back(tile);
+            }
+        }
+
+        size_t GetWalkableCount() const { return m_walkable.size(); }
+
+        // A rectangle of wall tiles, drawn as one scaled cube
+        struct WallBox {
+            int col, row;       // top left tile
+            int columns, rows;  // size in tiles
+        };
+
+        // Greedy meshing: covers every wall tile with as few boxes as the scan finds, each
+        // a horizontal run grown downwards while the rows below have the same run.
+        // Only tiles in [colBegin, colEnd) x [rowBegin, rowEnd), the whole map by default.
+        std::vector<WallBox> MergeWalls(int colBegin = 0, int rowBegin = 0, int colEnd = INT32_MAX, int rowEnd = INT32_MAX) const {
+            colBegin = std::max(colBegin, 0);
+            rowBegin = std::max(rowBegin, 0);
+            colEnd = std::min(colEnd, m_columns);
+            rowEnd = std::min(rowEnd, m_rows);
+            std::vector<WallBox> boxes;
+            if (colBegin >= colEnd || rowBegin >= rowEnd) return boxes;
+
+            int regionColumns = colEnd - colBegin;
+            std::vector<uint8_t> covered(size_t(regionColumns) * (rowEnd - rowBegin), 0);
+            auto uncovered = [&](int col, int row) {
+                return m_walls[size_t(row) * m_columns + col] && !covered[size_t(row - rowBegin) * regionColumns + col - colBegin];
+            };
+
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                for (int col = colBegin; col < colEnd; ++col) {
+                    if (!uncovered(col, row)) continue;
+                    int columns = 1;
+                    while (col + columns < colEnd && uncovered(col + columns, row)) columns++;
+                    int rows = 1;
+                    while (row + rows < rowEnd) {
+                        bool full = true;
+                        for (int c = col; c < col + columns && full; ++c) full = uncovered(c, row + rows);
+                        if (!full) break;
+                        rows++;
+                    }
+                    for (int r = row; r < row + rows; ++r) {
+                        memset(covered.data() + size_t(r - rowBegin) * regionColumns + col - colBegin, 1, columns);
+                    }
+                    boxes.push_back(WallBox{ col, row, columns, rows });
+                    col += columns - 1;
+                }
+            }
+            return boxes;
+        }
+
+        // Centre and size of a box in world units
+        void WallBoxBounds(const WallBox& box, float& x, float& y, float& width, float& height) const {
+            x = (float(box.col - m_originCol) + 0.5f * float(box.columns - 1)) * m_spacing;
+            y = (float(box.row - m_originRow) + 0.5f * float(box.rows - 1)) * m_spacing;
+            width = float(box.columns) * m_spacing;
+            height = float(box.rows) * m_spacing;
+        }
+
+        // Centre of a random walkable tile at least minPlayerDistance from (awayX, awayY)
+        // and minBodyDistance from every body's centre. random() returns uniformly
+        // distributed unsigned values. Tries `attempts` tiles, then drops the distances;
+        // false only if the map has no walkable tile.
+        template<typename Random>
+        bool PickWalkable(Random&& random, float awayX, float awayY, float minPlayerDistance, float minBodyDistance,
+                          float& x, float& y, int attempts = 32) const {
+            if (m_walkable.empty()) return false;
+
+            for (int i = 0; i <= attempts; ++i) {
+                uint32_t tile = m_walkable[static_cast<size_t>(random()) % m_walkable.size()];
+                TileCenter(int(tile % m_columns), int(tile / m_columns), x, y);
+                if (i == attempts) break; // unconstrained fallback
+
+                float dx = x - awayX, dy = y - awayY;
+                if (dx * dx + dy * dy < minPlayerDistance * minPlayerDistance) continue;
+                if (AnyBodyWithin(x, y, minBodyDistance)) continue;
+                return true;
+            }
+            return true;
+        }
+
+        void TileCenter(int col, int row, float& x, float& y) const {
+            x = float(col - m_originCol) * m_spacing;
+            y = float(row - m_originRow) * m_spacing;
+        }
+
+        // The tile whose cell contains (x, y), may lie outside the map
+        void WorldToTile(float x, float y, int& col, int& row) const {
+            col = static_cast<int>(std::floor(x / m_spacing + 0.5f)) + m_originCol;
+            row = static_cast<int>(std::floor(y / m_spacing + 0.5f)) + m_originRow;
+        }
+
+        int GetColumns() const { return m_columns; }
+        int GetRows() const { return m_rows; }
+        float GetSpacing() const { return m_spacing; }
+
+        // Movable square objects, bucketed by the cell of their centre. Returns an id for
+        // MoveBody and RemoveBody.
+        uint32_t AddBody(float x, float y, float halfExtent) {
+            uint32_t id = static_cast<uint32_t>(m_bodies.size());
+            m_bodies.push_back(Body{ x, y, halfExtent, CellKey(x, y), true });
+            m_cells[m_bodies.back().cell].push_back(id);
+            m_maxBodyHalfExtent = std::max(m_maxBodyHalfExtent, halfExtent);
+            return id;
+        }
+
+        void MoveBody(uint32_t id, float x, float y) {
+            if (id >= m_bodies.size() || !m_bodies[id].active) return;
+            Body& body = m_bodies[id];
+            body.x = x;
+            body.y = y;
+            uint64_t cell = CellKey(x, y);
+            if (cell == body.cell) return;
+            Unlink(id);
+            body.cell = cell;
+            m_cells[cell].push_back(id);
+        }
+
+        void RemoveBody(uint32_t id) {
+            if (id >= m_bodies.size() || !m_bodies[id].active) return;
+            Unlink(id);
+            m_bodies[id].active = false;
+        }
+
+        void ClearBodies() {
+            m_bodies.clear();
+            m_cells.clear();
+            m_maxBodyHalfExtent = 0.0f;
+        }
+
+        // True if a circle at (x, y) overlaps a wall tile or a body, ignoring height
+        bool OverlapsCircle(float x, float y, float radius) const {
+            float wallHalfExtent = 0.5f * m_spacing;
+
+            int colMin, rowMin, colMax, rowMax;
+            WorldToTile(x - radius - wallHalfExtent, y - radius - wallHalfExtent, colMin, rowMin);
+            WorldToTile(x + radius + wallHalfExtent, y + radius + wallHalfExtent, colMax, rowMax);
+            for (int row = std::max(rowMin, 0); row <= std::min(rowMax, m_rows - 1); ++row) {
+                for (int col = std::max(colMin, 0); col <= std::min(colMax, m_columns - 1); ++col) {
+                    if (!m_walls[size_t(row) * m_columns + col]) continue;
+                    float cx, cy;
+                    TileCenter(col, row, cx, cy);
+                    if (CircleOverlapsBox(x, y, radius, cx, cy, wallHalfExtent)) return true;
+                }
+            }
+
+            if (m_bodies.empty()) return false;
+            // a body sticks out of its cell by at most its half extent
+            float reach = radius + m_maxBodyHalfExtent;
+            WorldToTile(x - reach, y - reach, colMin, rowMin);
+            WorldToTile(x + reach, y + reach, colMax, rowMax);
+            for (int row = rowMin; row <= rowMax; ++row) {
+                for (int col = colMin; col <= colMax; ++col) {
+                    auto it = m_cells.find(PackCell(col, row));
+                    if (it == m_cells.end()) continue;
+                    for (uint32_t id : it->second) {
+                        const Body& body = m_bodies[id];
+                        if (CircleOverlapsBox(x, y, radius, body.x, body.y, body.halfExtent)) return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Moves a circle by (dx, dy) without passing through walls or bodies: it stops at the
+        // first contact and slides along it with what is left of the move. Long moves are
+        // split into steps of at most a tile so each sweep only looks at nearby cells.
+        // Returns true if anything was hit.
+        bool MoveCircle(float& x, float& y, float dx, float dy, float radius) const {
+            float length = std::sqrt(dx * dx + dy * dy);
+            if (length <= 0.0f) return false;
+            int steps = std::max(1, static_cast<int>(std::ceil(length / m_spacing)));
+            bool hit = false;
+
+            for (int step = 0; step < steps; ++step) {
+                float moveX = dx / steps, moveY = dy / steps;
+                for (int slide = 0; slide < MAX_SLIDES; ++slide) {
+                    float t, nx, ny;
+                    if (!SweepCircle(x, y, moveX, moveY, radius, t, nx, ny)) {
+                        x += moveX;
+                        y += moveY;
+                        break;
+                    }
+                    hit = true;
+                    // stop a little short of the contact, so the next sweep does not start inside
+                    float moveLength = std::sqrt(moveX * moveX + moveY * moveY);
+                    float advance = std::max(0.0f, t - SKIN / moveLength);
+                    x += moveX * advance + nx * SKIN;
+                    y += moveY * advance + ny * SKIN;
+
+                    // what is left of the move, without the part into the surface
+                    moveX *= 1.0f - t;
+                    moveY *= 1.0f - t;
+                    float into = moveX * nx + moveY * ny;
+                    moveX -= into * nx;
+                    moveY -= into * ny;
+                    if (moveX * moveX + moveY * moveY < SKIN * SKIN) break;
+                }
+            }
+            return hit;
+        }
+
+        // Earliest contact of a circle moving by (dx, dy) with a wall or body, as the fraction
+        // t of the move and the surface normal there
+        bool SweepCircle(float x, float y, float dx, float dy, float radius, float& t, float& nx, float& ny) const {
+            bool hit = false;
+            t = 1.0f;
+            auto consider = [&](float cx, float cy, float halfExtent) {
+                float boxT, boxNx, boxNy;
+                if (SweepCircleBox(x, y, dx, dy, radius, cx, cy, halfExtent, boxT, boxNx, boxNy) && boxT <= t) {
+                    t = boxT;
+                    nx = boxNx;
+                    ny = boxNy;
+                    hit = true;
+                }
+            };
+
+            float wallHalfExtent = 0.5f * m_spacing;
+            float minX = std::min(x, x + dx), maxX = std::max(x, x + dx);
+            float minY = std::min(y, y + dy), maxY = std::max(y, y + dy);
+            int colMin, rowMin, colMax, rowMax;
+            WorldToTile(minX - radius - wallHalfExtent, minY - radius - wallHalfExtent, colMin, rowMin);
+            WorldToTile(maxX + radius + wallHalfExtent, maxY + radius + wallHalfExtent, colMax, rowMax);
+            for (int row = std::max(rowMin, 0); row <= std::min(rowMax, m_rows - 1); ++row) {
+                for (int col = std::max(colMin, 0); col <= std::min(colMax, m_columns - 1); ++col) {
+                    if (!m_walls[size_t(row) * m_columns + col]) continue;
+                    float cx, cy;
+                    TileCenter(col, row, cx, cy);
+                    consider(cx, cy, wallHalfExtent);
+                }
+            }
+
+            if (!m_bodies.empty()) {
+                float reach = radius + m_maxBodyHalfExtent;
+                WorldToTile(minX - reach, minY - reach, colMin, rowMin);
+                WorldToTile(maxX + reach, maxY + reach, colMax, rowMax);
+                for (int row = rowMin; row <= rowMax; ++row) {
+                    for (int col = colMin; col <= colMax; ++col) {
+                        auto it = m_cells.find(PackCell(col, row));
+                        if (it == m_cells.end()) continue;
+                        for (uint32_t id : it->second) consider(m_bodies[id].x, m_bodies[id].y, m_bodies[id].halfExtent);
+                    }
+                }
+            }
+            return hit;
+        }
+
+        // Swept circle against an axis-aligned square: the circle's centre as a ray against
+        // the square grown by the radius, with rounded corners. A circle that already
+        // overlaps only hits if it moves further in.
+        static bool SweepCircleBox(float x, float y, float dx, float dy, float radius, float cx, float cy, float halfExtent,
+                                   float& t, float& nx, float& ny) {
+            float px = x - cx, py = y - cy; // relative to the box centre
+
+            if (CircleOverlapsBox(x, y, radius, cx, cy, halfExtent)) {
+                float qx = std::min(std::max(px, -halfExtent), halfExtent);
+                float qy = std::min(std::max(py, -halfExtent), halfExtent);
+                nx = px - qx;
+                ny = py - qy;
+                float distance = std::sqrt(nx * nx + ny * ny);
+                if (distance > 0.0f) {
+                    nx /= distance;
+                    ny /= distance;
+                } else {
+                    // centre inside the box, out through the nearest face
+                    bool alongX = halfExtent - std::abs(px) < halfExtent - std::abs(py);
+                    nx = alongX ? (px < 0.0f ? -1.0f : 1.0f) : 0.0f;
+                    ny = alongX ? 0.0f : (py < 0.0f ? -1.0f : 1.0f);
+                }
+                t = 0.0f;
+                return dx * nx + dy * ny < 0.0f;
+            }
+
+            bool hit = false;
+            t = 1.0f;
+            float outer = halfExtent + radius;
+            // faces, only where the contact point lies along the side
+            auto face = [&](float start, float delta, float along, float alongDelta, float faceNx, float faceNy, float sign) {
+                if (delta * sign >= 0.0f) return; // moving away from this face
+                float faceT = (sign * outer - start) / delta;
+                // on the surface within rounding counts as touching, further back is behind us
+                if (outer - start * sign > SKIN) return;
+                faceT = std::max(faceT, 0.0f);
+                if (faceT > t) return;
+                float contact = along + alongDelta * faceT;
+                if (contact < -halfExtent || contact > halfExtent) return;
+                t = faceT;
+                nx = faceNx;
+                ny = faceNy;
+                hit = true;
+            };
+            face(px, dx, py, dy, -1.0f, 0.0f, -1.0f);
+            face(px, dx, py, dy, 1.0f, 0.0f, 1.0f);
+            face(py, dy, px, dx, 0.0f, -1.0f, -1.0f);
+            face(py, dy, px, dx, 0.0f, 1.0f, 1.0f);
+
+            // corners, a circle of the radius around each
+            float a = dx * dx + dy * dy;
+            if (a <= 0.0f) return hit;
+            for (int corner = 0; corner < 4; ++corner) {
+                float kx = (corner & 1) ? halfExtent : -halfExtent;
+                float ky = (corner & 2) ? halfExtent : -halfExtent;
+                float ox = px - kx, oy = py - ky;
+                float b = ox * dx + oy * dy;
+                if (b >= 0.0f) continue; // moving away from the corner
+                float c = ox * ox + oy * oy - radius * radius;
+                float discriminant = b * b - a * c;
+                if (discriminant < 0.0f) continue;
+                float cornerT = c <= 0.0f ? 0.0f : (-b - std::sqrt(discriminant)) / a; // touching within rounding
+                if (cornerT > t) continue;
+                t = cornerT;
+                nx = (ox + dx * cornerT) / radius;
+                ny = (oy + dy * cornerT) / radius;
+                hit = true;
+            }
+            return hit;
+        }
+
+        // True if the centre of a body lies closer than distance to (x, y)
+        bool AnyBodyWithin(float x, float y, float distance) const {
+            if (m_bodies.empty() || distance <= 0.0f) return false;
+            int colMin, rowMin, colMax, rowMax;
+            WorldToTile(x - distance, y - distance, colMin, rowMin);
+            WorldToTile(x + distance, y + distance, colMax, rowMax);
+            for (int row = rowMin; row <= rowMax; ++row) {
+                for (int col = colMin; col <= colMax; ++col) {
+                    auto it = m_cells.find(PackCell(col, row));
+                    if (it == m_cells.end()) continue;
+                    for (uint32_t id : it->second) {
+                        float dx = m_bodies[id].x - x, dy = m_bodies[id].y - y;
+                        if (dx * dx + dy * dy < distance * distance) return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        static bool CircleOverlapsBox(float x, float y, float radius, float cx, float cy, float halfExtent) {
+            float dx = x - std::min(std::max(x, cx - halfExtent), cx + halfExtent);
+            float dy = y - std::min(std::max(y, cy - halfExtent), cy + halfExtent);
+            return dx * dx + dy * dy < radius * radius;
+        }
+
+    private:
+        static constexpr uint32_t NOT_WALKABLE = 0xFFFFFFFFu;
+        static constexpr int MAX_SLIDES = 3;    // contacts handled per step, a corner needs two
+        static constexpr float SKIN = 1e-3f;    // gap kept to a contact, above float rounding on large maps
+
+        struct Body {
+            float x, y;
+            float halfExtent;
+            uint64_t cell;
+            bool active;
+        };
+
+        static uint64_t PackCell(int col, int row) {
+            return (uint64_t(uint32_t(row)) << 32) | uint32_t(col);
+        }
+
+        uint64_t CellKey(float x, float y) const {
+            int col, row;
+            WorldToTile(x, y, col, row);
+            return PackCell(col, row);
+        }
+
+        void Unlink(uint32_t id) {
+            auto it = m_cells.find(m_bodies[id].cell);
+            if (it == m_cells.end()) return;
+            auto& ids = it->second;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (ids[i] == id) {
+                    ids[i] = ids.back();
+                    ids.pop_back();
+                    break;
+                }
+            }
+            if (ids.empty()) m_cells.erase(it);
+        }
+
+        int m_columns = 0;
+        int m_rows = 0;
+        int m_originCol = 0;
+        int m_originRow = 0;
+        float m_spacing = 1.0f;
+        std::vector<uint8_t> m_walls; // row-major, 1 = wall
+        std::vector<uint32_t> m_walkable;     // tile indices, unordered
+        std::vector<uint32_t> m_walkableSlot; // by tile, position in m_walkable or NOT_WALKABLE
+
+        std::vector<Body> m_bodies;   // by id, removed ones stay inactive
+        std::unordered_map<uint64_t, std::vector<uint32_t>> m_cells;
+        float m_maxBodyHalfExtent = 0.0f;
+};
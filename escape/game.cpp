@@ -27,290 +27,682 @@ extern "C" {
 #include <thread>
 #include <map> 
 #include <unordered_map>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
 #include <algorithm> 
+#include <cctype>
 #include <SDL.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAME_HASH_SSE2 1
+#endif
+
 #include "stb_image_write.h"
+#include "stream_trace.h"
+#include "stream_log.h"
+#include "mpsc_queue.h"
+#include "stream_stats.h"
+#include "stream_sender.h"
+#include "frame_ring.h"
+#include "collision_grid.h"
+#include "tile_map.h"
+#include "player_sim.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
-typedef struct RTHeader {
-    double time;
-    unsigned long packetnum;
-} RTHeader_t;
-
-#pragma pack(push, 1)
-typedef struct FragmentHeader {
-    uint32_t frame_id;
-    uint16_t total_fragments;
-    uint16_t fragment_index;
-} FragmentHeader_t;
-#pragma pack(pop)
-
 constexpr uint16_t LISTEN_PORT = 8888;
+constexpr float STREAM_FPS = 25.0f;
 std::atomic<bool> runInputThread{true};
 
-class UDPsend {
-    public:
-        int sock = 0;
-        struct sockaddr_in6 addr;
-        unsigned int packetnum = 0;
+// Stream: mux the packets that are already encoded for streaming (no extra encode).
+// RawPipe: pipe raw RGBA into a separate ffmpeg process, only for high quality captures.
+enum class RecordMode { Off, Stream, RawPipe };
+constexpr RecordMode RECORD_MODE = RecordMode::Stream;
 
-        static constexpr int MTU = 1400;
-        static constexpr int HEADER_SIZE = sizeof(RTHeader_t) + sizeof(FragmentHeader_t);
-        static constexpr int MAX_PAYLOAD = MTU - HEADER_SIZE;
+// recording.mp4 first, recording_1.mp4, recording_2.mp4, ... after each change of the stream size
+inline std::string RecordingPath(int segment) {
+    const char* base = "C:/Users/aanny/source/repos/fork/escape/videos/recording";
+    return segment == 0 ? std::format("{}.mp4", base) : std::format("{}_{}.mp4", base, segment);
+}
 
-        UDPsend() {};
+// Counts the heap allocations of each thread, the "Stream Stats" panel shows those of
+// building the imgui windows. Configure with -DCOUNT_ALLOCATIONS=ON.
+#ifdef COUNT_ALLOCATIONS
+thread_local uint64_t threadAllocations = 0;
 
-        ~UDPsend() {};
+void* operator new(size_t size) {
+    threadAllocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
 
-        void init(const char *address, int port) {
-            sock = socket( AF_INET6, SOCK_DGRAM, 0);
-            struct addrinfo hints;
+inline uint64_t ThreadAllocations() { return threadAllocations; }
+#else
+inline uint64_t ThreadAllocations() { return 0; }
+#endif
 
-            memset(&addr, 0, sizeof(addr));
-            memset(&hints, 0, sizeof(hints));
+// Extra named entities without a model, to measure the "Scene Objects" list at scale (e.g. 10000)
+constexpr int SCENE_LIST_TEST_ENTITIES = 0;
 
-            hints.ai_family = AF_INET6;
-            hints.ai_socktype = SOCK_DGRAM;
-            hints.ai_flags = 0;
+// Static scene handling: unchanged frames after this many are not encoded,
+// frames where less than this share of the screen changed get an ROI hint.
+constexpr int STATIC_FRAMES_BEFORE_SKIP = 2;
+constexpr float ROI_MAX_FRACTION = 0.5f;
 
-            struct addrinfo *result = NULL;
-            auto dwRetval = getaddrinfo(address, nullptr, &hints, &result);
-            if ( dwRetval != 0 ) {
-                printf("getaddrinfo failed with error: %d\n", dwRetval);
-                return;
-            }
-            for (addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next) {
-                if (ptr->ai_family == AF_INET6) {
-                    memcpy(&addr, ptr->ai_addr, ptr->ai_addrlen);
-                    addr.sin6_port = htons(port);
-                    addr.sin6_family = AF_INET6;
-                }
-            }
-            freeaddrinfo(result);
-        };
-        
+// Simulcast subscription: a receiver drops one layer when its reported loss exceeds
+// LAYER_DOWN_LOSS, and goes up again after LAYER_UP_REPORTS reports below LAYER_UP_LOSS.
+constexpr float LAYER_DOWN_LOSS = 0.05f;
+constexpr float LAYER_UP_LOSS = 0.01f;
+constexpr int LAYER_UP_REPORTS = 3;
+// receivers report every 2 s, one that missed this many seconds of reports is dropped
+constexpr double SUBSCRIBER_TIMEOUT = 10.0;
 
-        int send_fragmented(char* buffer, int len) {
-            packetnum++; // new frame ID
-            
-            int total_fragments = (len + MAX_PAYLOAD - 1) / MAX_PAYLOAD;
-        
-            for (int i = 0; i < total_fragments; ++i) {
-                int payload_size = std::min(MAX_PAYLOAD, len - i * MAX_PAYLOAD);
-        
-                char sendbuffer[MTU];
+constexpr uint8_t PACKET_RECEIVER_REPORT = 0x01;
+constexpr uint8_t PACKET_INPUT = 0x02;
 
-                RTHeader_t rt_header;
-                auto now = std::chrono::steady_clock::now();
-                rt_header.time = std::chrono::duration<double>(now.time_since_epoch()).count();
-                rt_header.packetnum = packetnum;
-                // std::cout << "rt_header.packetnum: " << rt_header.packetnum << std::endl;
+constexpr uint8_t INPUT_MOUSE = 0x01;
+constexpr int INPUT_EVENT_HISTORY = 8;
 
+#pragma pack(push, 1)
+struct ReceiverReport {
+    uint8_t  type;
+    uint16_t video_port;
+    double   timestamp;
+    uint32_t bytes_received;
+    uint32_t expected_packets;
+    uint32_t received_packets;
+    float    frame_rate;
+};
 
-                FragmentHeader_t frag_header;
-                frag_header.frame_id = packetnum;
-                frag_header.total_fragments = total_fragments;
-                frag_header.fragment_index = i;
-                // std::cout << "frag_header.frame_id: " << frag_header.frame_id << std::endl;
+// Sent on every key change and repeated while keys are held, so a lost packet is
+// healed by the next one. The last key edges travel along in every packet.
+struct InputPacket {
+    uint8_t  type;           // PACKET_INPUT
+    uint8_t  flags;          // INPUT_MOUSE
+    uint16_t key_state;      // held keys, bit per InputKey
+    uint32_t sequence;
+    double   timestamp;      // receiver clock, seconds
+    int16_t  mouse_dx;
+    int16_t  mouse_dy;
+    uint32_t event_sequence; // sequence of events[0]; events[i] has event_sequence - i
+    uint8_t  events[INPUT_EVENT_HISTORY]; // InputKey | 0x80 when pressed, newest first
+};
+#pragma pack(pop)
 
-        
-                memcpy(sendbuffer, &rt_header, sizeof(rt_header));
-                memcpy(sendbuffer + sizeof(rt_header), &frag_header, sizeof(frag_header));
-                memcpy(sendbuffer + HEADER_SIZE, buffer + i * MAX_PAYLOAD, payload_size);
-        
-                int ret = sendto(sock, sendbuffer, HEADER_SIZE + payload_size, 0,
-                                 (const sockaddr*)&addr, sizeof(addr));
-                    // std::cout << "HEADER_SIZE: " << HEADER_SIZE << std::endl;
-                if (ret < 0) {
-                    std::cerr << "Failed to send fragment " << i << "\n";
-                    return ret;
+class FrameChangeDetector {
+    public:
+        static constexpr int BLOCK_SIZE = 32; // pixels
+
+        DirtyRegion Update(const uint8_t* rgba, int width, int height) {
+            int blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            int blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+            DirtyRegion region;
+            if (width != m_width || height != m_height) {
+                m_width = width;
+                m_height = height;
+                m_hashes.assign(size_t(blocksX) * blocksY, 0);
+                m_valid = false;
+            }
+
+            int minX = blocksX, minY = blocksY, maxX = -1, maxY = -1, dirty = 0;
+            for (int by = 0; by < blocksY; ++by) {
+                for (int bx = 0; bx < blocksX; ++bx) {
+                    uint32_t hash = HashBlock(rgba, bx * BLOCK_SIZE, by * BLOCK_SIZE);
+                    uint32_t& previous = m_hashes[size_t(by) * blocksX + bx];
+                    if (hash == previous && m_valid) continue;
+
+                    previous = hash;
+                    dirty++;
+                    minX = std::min(minX, bx); maxX = std::max(maxX, bx);
+                    minY = std::min(minY, by); maxY = std::max(maxY, by);
                 }
             }
-        
-            return total_fragments;
-        }
-        
-        void closeSock() {
-            closesocket(sock);
-            sock=0;
-        };
-};
 
-class FrameLimiter {
-    public:
-    FrameLimiter(float targetFPS)
-    : m_frameDuration
-        (
-        std::chrono::duration_cast<std::chrono::steady_clock::duration>
-            (
-            std::chrono::duration<float>(1.0f / targetFPS)
-            )
-        ),
-    m_nextFrameTime
-        (
-        std::chrono::steady_clock::now()
-        ) {}
+            if (!m_valid) {
+                m_valid = true;
+                region.right = width;
+                region.bottom = height;
+                return region;
+            }
 
-    
-        void Wait() {
-            auto now = std::chrono::steady_clock::now();
-    
-            if (now < m_nextFrameTime) {
-                std::this_thread::sleep_until(m_nextFrameTime);
+            region.changed = dirty > 0;
+            region.fraction = float(dirty) / float(blocksX * blocksY);
+            if (region.changed) {
+                region.left = minX * BLOCK_SIZE;
+                region.top = minY * BLOCK_SIZE;
+                region.right = std::min(width, (maxX + 1) * BLOCK_SIZE);
+                region.bottom = std::min(height, (maxY + 1) * BLOCK_SIZE);
             }
-    
-            m_nextFrameTime += m_frameDuration;
+            return region;
         }
-    
+
     private:
-        std::chrono::steady_clock::duration m_frameDuration;
-        std::chrono::steady_clock::time_point m_nextFrameTime;
+        // Order dependent h = h * 31 + v over 32-bit words, four lanes at a time
+        uint32_t HashBlock(const uint8_t* rgba, int x0, int y0) const {
+            int x1 = std::min(x0 + BLOCK_SIZE, m_width);
+            int y1 = std::min(y0 + BLOCK_SIZE, m_height);
+            size_t stride = size_t(m_width) * 4;
+
+            uint32_t hash = 2166136261u;
+        #ifdef FRAME_HASH_SSE2
+            __m128i acc = _mm_set1_epi32((int)hash);
+        #endif
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* row = rgba + y * stride + size_t(x0) * 4;
+                int x = x0;
+        #ifdef FRAME_HASH_SSE2
+                for (; x + 4 <= x1; x += 4, row += 16) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+                    acc = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(acc, 5), acc), v);
+                }
+        #endif
+                for (; x < x1; ++x, row += 4) {
+                    uint32_t v;
+                    memcpy(&v, row, 4);
+                    hash = hash * 31 + v;
+                }
+            }
+
+        #ifdef FRAME_HASH_SSE2
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            for (uint32_t lane : lanes) hash = (hash ^ lane) * 16777619u;
+        #endif
+            return hash;
+        }
+
+        int m_width = 0;
+        int m_height = 0;
+        bool m_valid = false;
+        std::vector<uint32_t> m_hashes;
 };
-    
+
 class FFmpegWriter {
     public:
-        FFmpegWriter(int width, int height, const std::string& outputFile)
+        using OverflowPolicy = FrameRing::OverflowPolicy;
+
+        FFmpegWriter(int width, int height, const std::string& outputFile,
+                     OverflowPolicy policy = OverflowPolicy::Drop, size_t ringSize = 8)
             : m_width(width), m_height(height)
         {
             std::string cmd = std::format(
-                R"(ffmpeg -y -f rawvideo -pixel_format rgba -video_size {}x{} -framerate 60 -i - -c:v libx264 -preset ultrafast -pix_fmt yuv420p -f h264 "{}")",
-                width, height, outputFile
+                R"(ffmpeg -y -f rawvideo -pixel_format rgba -video_size {}x{} -framerate {} -i - -c:v libx264 -preset ultrafast -pix_fmt yuv420p -f h264 "{}")",
+                width, height, (int)STREAM_FPS, outputFile
             );
     
             m_pipe = _popen(cmd.c_str(), "wb");
             if (!m_pipe) {
                 std::cerr << "Failed to start FFmpeg." << std::endl;
+                return;
             }
+
+            // the pipe write happens on the ring's writer thread
+            m_ring = std::make_unique<FrameRing>(size_t(width) * height * 4,
+                [this](const uint8_t* data, size_t size) { fwrite(data, 1, size, m_pipe); },
+                policy, ringSize, "raw recording writer");
         }
     
         void WriteFrame(const uint8_t* frameData) {
-            if (m_pipe) {
-                fwrite(frameData, 1, m_width * m_height * 4, m_pipe);
-            }
+            if (m_ring) m_ring->WriteFrame(frameData);
         }
     
         ~FFmpegWriter() {
+            m_ring.reset(); // writes what is still queued
+
             if (m_pipe) {
                 _pclose(m_pipe);
             }
         }
+
+        uint64_t GetDroppedFrames() const { return m_ring ? m_ring->GetDroppedFrames() : 0; }
+        size_t GetHighWaterMark() const { return m_ring ? m_ring->GetHighWaterMark() : 0; }
+        size_t GetQueueDepth() { return m_ring ? m_ring->GetQueueDepth() : 0; }
     
     private:
         int m_width;
         int m_height;
         FILE* m_pipe = nullptr;
+        std::unique_ptr<FrameRing> m_ring;
 };
 
-class FFmpegEncoder {
+// Picks the stream resolution from the bits per pixel the encoder can spend and
+// from how much of the frame budget encoding takes. Evaluated once per second.
+class ResolutionPolicy {
     public:
-        FFmpegEncoder(int width, int height) 
-            : m_width(width), m_height(height)
+        static constexpr float SCALES[] = { 1.0f, 0.75f, 0.5f, 0.375f };
+        static constexpr int SCALE_COUNT = sizeof(SCALES) / sizeof(SCALES[0]);
+
+        ResolutionPolicy(int64_t targetBitRate, float fps)
+            : m_targetBitRate(targetBitRate), m_fps(fps) {}
+
+        void OnFrameEncoded(int bytes, double encodeMs) {
+            m_bytes += bytes;
+            m_encodeMs += encodeMs;
+            m_frames++;
+        }
+
+        // Returns true when the scale changed
+        bool Evaluate(int width, int height) {
+            if (m_frames < (int)m_fps) return false;
+
+            double bitRate = m_bytes * 8.0 * m_fps / m_frames;
+            double encodeShare = (m_encodeMs / m_frames) / (1000.0 / m_fps);
+            double bitsPerPixel = bitRate / (double(width) * height * m_fps);
+            m_bytes = 0;
+            m_encodeMs = 0.0;
+            m_frames = 0;
+
+            // the encoder hits its budget and still has few bits per pixel: fewer, sharper pixels
+            bool starved = bitRate > 0.9 * m_targetBitRate && bitsPerPixel < LOW_BITS_PER_PIXEL;
+            bool tooSlow = encodeShare > 0.7;
+            bool headroom = bitsPerPixel > HIGH_BITS_PER_PIXEL && encodeShare < 0.4;
+
+            int previous = m_step;
+            if ((starved || tooSlow) && m_step + 1 < SCALE_COUNT) {
+                m_step++;
+                m_upVotes = 0;
+            } else if (headroom && m_step > 0) {
+                // go up slowly, a wrong step up costs a full IDR
+                if (++m_upVotes >= UP_SWITCH_SECONDS) {
+                    m_step--;
+                    m_upVotes = 0;
+                }
+            } else {
+                m_upVotes = 0;
+            }
+            return m_step != previous;
+        }
+
+        float GetScale() const { return SCALES[m_step]; }
+
+    private:
+        static constexpr double LOW_BITS_PER_PIXEL = 0.04;
+        static constexpr double HIGH_BITS_PER_PIXEL = 0.1;
+        static constexpr int UP_SWITCH_SECONDS = 5;
+
+        int64_t m_targetBitRate;
+        float m_fps;
+        int m_step = 0;
+        int m_upVotes = 0;
+
+        uint64_t m_bytes = 0;
+        double m_encodeMs = 0.0;
+        int m_frames = 0;
+};
+
+// RGBA capture converted to YUV420P once at the base size, every further level
+// is downscaled from the previous one (YUV → YUV) at half the size
+class ScalePyramid {
+    public:
+        ScalePyramid(int srcWidth, int srcHeight, int levels)
+            : m_srcWidth(srcWidth), m_srcHeight(srcHeight), m_levels(levels, nullptr), m_scalers(levels, nullptr)
         {
-    
-            const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-            if (!codec) {
-                std::cerr << "Codec not found\n";
-                return;
+            Resize(srcWidth, srcHeight);
+        }
+
+        ~ScalePyramid() {
+            Free();
+        }
+
+        void Resize(int baseWidth, int baseHeight) {
+            Free();
+
+            AVPixelFormat srcFormat = AV_PIX_FMT_RGBA;
+            int srcWidth = m_srcWidth, srcHeight = m_srcHeight;
+            for (size_t i = 0; i < m_levels.size(); ++i) {
+                int width = std::max(2, (baseWidth >> i) & ~1);
+                int height = std::max(2, (baseHeight >> i) & ~1);
+
+                m_levels[i] = av_frame_alloc();
+                m_levels[i]->format = AV_PIX_FMT_YUV420P;
+                m_levels[i]->width = width;
+                m_levels[i]->height = height;
+                av_frame_get_buffer(m_levels[i], 32);
+
+                m_scalers[i] = sws_getContext(
+                    srcWidth, srcHeight, srcFormat,
+                    width, height, AV_PIX_FMT_YUV420P,
+                    SWS_BILINEAR, nullptr, nullptr, nullptr
+                );
+                if (!m_scalers[i]) std::cerr << "Could not allocate SwsContext for level " << i << "\n";
+
+                srcFormat = AV_PIX_FMT_YUV420P;
+                srcWidth = width;
+                srcHeight = height;
             }
-            m_codecCtx = avcodec_alloc_context3(codec);
-            if (!m_codecCtx) {
-                std::cerr << "Could not allocate codec context\n";
-                return;
+        }
+
+        // Computes levels [0, levelCount)
+        void Build(const uint8_t* rgba, int levelCount) {
+            TRACE_SCOPE("sws_scale");
+            const uint8_t* srcSlice[] = { rgba };
+            int srcStride[] = { 4 * m_srcWidth };
+            sws_scale(m_scalers[0], srcSlice, srcStride, 0, m_srcHeight, m_levels[0]->data, m_levels[0]->linesize);
+
+            for (int i = 1; i < levelCount && i < (int)m_levels.size(); ++i) {
+                AVFrame* src = m_levels[i - 1];
+                sws_scale(m_scalers[i], src->data, src->linesize, 0, src->height, m_levels[i]->data, m_levels[i]->linesize);
             }
+        }
 
-            m_codecCtx->bit_rate = 400000;
-            m_codecCtx->width = m_width;
-            m_codecCtx->height = m_height;
-            m_codecCtx->time_base = {1, 60};
-            m_codecCtx->framerate = {60, 1};
-            m_codecCtx->gop_size = 10;
-            m_codecCtx->max_b_frames = 1;
-            m_codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
-    
-            av_opt_set(m_codecCtx->priv_data, "annexb", "1", 0);
+        AVFrame* GetLevel(int i) { return m_levels[i]; }
 
-            if (avcodec_open2(m_codecCtx, codec, NULL) < 0) {
-                std::cerr << "Could not open codec\n";
-                return;
+    private:
+        void Free() {
+            for (auto& scaler : m_scalers) { sws_freeContext(scaler); scaler = nullptr; }
+            for (auto& level : m_levels) av_frame_free(&level);
+        }
+
+        int m_srcWidth, m_srcHeight;
+        std::vector<AVFrame*> m_levels;
+        std::vector<SwsContext*> m_scalers;
+};
+
+// Full, half and quarter resolution layers encoded from one capture
+class SimulcastEncoder {
+    public:
+        static constexpr int LAYER_COUNT = 3;
+        static constexpr int64_t LAYER_BIT_RATES[LAYER_COUNT] = { FFmpegEncoder::BIT_RATE, 160000, 64000 };
+
+        SimulcastEncoder(int width, int height, int fps)
+            : m_width(width), m_height(height), m_pyramid(width, height, LAYER_COUNT)
+        {
+            for (int i = 0; i < LAYER_COUNT; ++i) {
+                AVFrame* level = m_pyramid.GetLevel(i);
+                m_layers.push_back(std::make_unique<FFmpegEncoder>(width, height, fps, LAYER_BIT_RATES[i], level->width, level->height));
             }
-    
-            m_frame = av_frame_alloc();
-            if (!m_frame) {
-                std::cerr << "Could not allocate frame\n";
-                return;
+        }
+
+        // Scales the whole pyramid, used by the dynamic resolution policy. Packets a layer
+        // still held are passed to onPacket(layer, const AVPacket*) before it is reopened.
+        template<typename OnPacket>
+        void SetBaseScale(float scale, OnPacket onPacket) {
+            m_pyramid.Resize(int(m_width * scale), int(m_height * scale));
+            for (int i = 0; i < LAYER_COUNT; ++i) {
+                AVFrame* level = m_pyramid.GetLevel(i);
+                m_layers[i]->SetOutputSize(level->width, level->height,
+                                           [&](const AVPacket* packet) { onPacket(i, packet); });
             }
+        }
 
-            m_frame->format = m_codecCtx->pix_fmt;
-            m_frame->width = m_codecCtx->width;
-            m_frame->height = m_codecCtx->height;
-            av_frame_get_buffer(m_frame, 32);
-    
-            m_packet = av_packet_alloc();
-            if (!m_packet) {
-                std::cerr << "Could not allocate packet\n";
+        // Encodes the layers set in layerMask, the others only advance their timestamps
+        void Encode(const uint8_t* rgba, const DirtyRegion* roi, unsigned layerMask) {
+            int levelCount = 0;
+            for (int i = 0; i < LAYER_COUNT; ++i) {
+                m_results[i] = { nullptr, 0 };
+                if (layerMask & (1u << i)) levelCount = i + 1;
+            }
+            if (levelCount == 0) {
+                SkipFrame();
                 return;
             }
 
-    
-            // SwsContext to convert from RGBA to YUV420P
-            m_swsCtx = sws_getContext(
-                width, height, AV_PIX_FMT_RGBA,
-                width, height, AV_PIX_FMT_YUV420P,
-                SWS_BILINEAR, nullptr, nullptr, nullptr
-            );
-            if (!m_swsCtx) {
-                std::cerr << "Could not allocate SwsContext\n";
-                return;
+            auto start = std::chrono::steady_clock::now();
+            m_pyramid.Build(rgba, levelCount);
+            auto end = std::chrono::steady_clock::now();
+            m_pyramidMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+            for (int i = 0; i < LAYER_COUNT; ++i) {
+                m_encodeMs[i] = 0.0;
+                if (!(layerMask & (1u << i))) {
+                    m_layers[i]->SkipFrame();
+                    continue;
+                }
+
+                start = std::chrono::steady_clock::now();
+                m_results[i] = m_layers[i]->EncodePicture(m_pyramid.GetLevel(i), roi);
+                end = std::chrono::steady_clock::now();
+                m_encodeMs[i] = std::chrono::duration<double, std::milli>(end - start).count();
             }
         }
-    
-        ~FFmpegEncoder() {
-            sws_freeContext(m_swsCtx);
-            av_packet_free(&m_packet);
-            av_frame_free(&m_frame);
-            avcodec_free_context(&m_codecCtx);
+
+        void SkipFrame() {
+            for (auto& layer : m_layers) layer->SkipFrame();
         }
-    
-        // Returns encoded H.264 buffer (in packet), and size
-        std::pair<uint8_t*, int> EncodeFrame(const uint8_t* rgbaData) {
-            const uint8_t* srcSlice[] = { rgbaData };
-            int srcStride[] = { 4 * m_width };
-    
-            // Convert RGBA → YUV420P
-            sws_scale(m_swsCtx, srcSlice, srcStride, 0, m_height, m_frame->data, m_frame->linesize);
-    
-            m_frame->pts = m_pts++;
-    
-            // Send frame to encoder
-            int ret = avcodec_send_frame(m_codecCtx, m_frame);
-            if (ret < 0) return {nullptr, 0};
-    
-            ret = avcodec_receive_packet(m_codecCtx, m_packet);
-            if (ret < 0) return {nullptr, 0};
-    
-            // Return pointer and size (packet data is owned by FFmpeg)
-            return { m_packet->data, m_packet->size };
+
+        void RequestKeyFrame() {
+            for (auto& layer : m_layers) layer->RequestKeyFrame();
         }
-    
-        void FreePacket() {
-            av_packet_unref(m_packet);
+
+        // Encoded packet of the last Encode call, {nullptr, 0} if the layer produced none
+        std::pair<uint8_t*, int> GetResult(int layer) const { return m_results[layer]; }
+
+        void FreePackets() {
+            for (auto& layer : m_layers) layer->FreePacket();
         }
-    
+
+        FFmpegEncoder& GetLayer(int layer) { return *m_layers[layer]; }
+        double GetPyramidMs() const { return m_pyramidMs; }
+        double GetEncodeMs(int layer) const { return m_encodeMs[layer]; }
+
     private:
         int m_width, m_height;
-        int m_pts = 0;
-        AVCodecContext* m_codecCtx = nullptr;
-        AVFrame* m_frame = nullptr;
-        AVPacket* m_packet = nullptr;
-        SwsContext* m_swsCtx = nullptr;
+        ScalePyramid m_pyramid;
+        std::vector<std::unique_ptr<FFmpegEncoder>> m_layers;
+        std::pair<uint8_t*, int> m_results[LAYER_COUNT] = {};
+        double m_pyramidMs = 0.0;
+        double m_encodeMs[LAYER_COUNT] = {};
+};
+
+class StreamRecorder {
+    public:
+        // container is picked from the file extension (.mp4, .mkv, ...)
+        StreamRecorder(const std::string& outputFile, const AVCodecContext* codecCtx) {
+            m_running = true;
+            m_thread = std::thread(&StreamRecorder::Run, this);
+            StartSegment(outputFile, codecCtx);
+        }
+
+        ~StreamRecorder() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+            m_condVar.notify_one();
+            if (m_thread.joinable()) m_thread.join();
+            CloseSegment();
+        }
+
+        // Finishes the current file and records the following packets into a new one, for
+        // an encoder that was reopened with other parameters (size, SPS). The files are
+        // switched on the recorder thread, in order with the packets.
+        void StartSegment(const std::string& outputFile, const AVCodecContext* codecCtx) {
+            QueueItem item;
+            item.segment = std::make_unique<Segment>();
+            item.segment->path = outputFile;
+            item.segment->par = avcodec_parameters_alloc();
+            if (!item.segment->par) return;
+            avcodec_parameters_from_context(item.segment->par, codecCtx);
+            item.segment->timeBase = codecCtx->time_base;
+            item.segment->frameRate = codecCtx->framerate;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push(std::move(item));
+            m_condVar.notify_one();
+        }
+
+        // Takes a reference to an encoded packet; muxing and disk I/O happen on the recorder thread
+        void WritePacket(const AVPacket* packet) {
+            QueueItem item;
+            item.packet = av_packet_clone(packet);
+            if (!item.packet) return;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push(std::move(item));
+            m_condVar.notify_one();
+        }
+
+        size_t GetQueueDepth() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_queue.size();
+        }
+
+    private:
+        struct Segment {
+            std::string path;
+            AVCodecParameters* par = nullptr;
+            AVRational timeBase;
+            AVRational frameRate;
+
+            ~Segment() { avcodec_parameters_free(&par); }
+        };
+
+        // either a packet or the start of a new file
+        struct QueueItem {
+            AVPacket* packet = nullptr;
+            std::unique_ptr<Segment> segment;
+        };
+
+        void Run() {
+            TRACE_THREAD_NAME("stream recorder");
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_condVar.wait(lock, [this] { return !m_queue.empty() || !m_running; });
+                if (m_queue.empty()) break;
+
+                QueueItem item = std::move(m_queue.front());
+                m_queue.pop();
+                lock.unlock();
+
+                if (item.segment) {
+                    CloseSegment();
+                    OpenSegment(*item.segment);
+                } else {
+                    Mux(item.packet);
+                    av_packet_free(&item.packet);
+                }
+
+                lock.lock();
+            }
+        }
+
+        void OpenSegment(const Segment& segment) {
+            avformat_alloc_output_context2(&m_formatCtx, nullptr, nullptr, segment.path.c_str());
+            if (!m_formatCtx) {
+                std::cerr << "Could not create output context for " << segment.path << "\n";
+                return;
+            }
+
+            m_stream = avformat_new_stream(m_formatCtx, nullptr);
+            if (!m_stream) {
+                std::cerr << "Could not create output stream\n";
+                CloseSegment();
+                return;
+            }
+            avcodec_parameters_copy(m_stream->codecpar, segment.par);
+            m_stream->time_base = segment.timeBase;
+            m_stream->avg_frame_rate = segment.frameRate;
+            m_codecTimeBase = segment.timeBase;
+
+            if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE)) {
+                if (avio_open(&m_formatCtx->pb, segment.path.c_str(), AVIO_FLAG_WRITE) < 0) {
+                    std::cerr << "Could not open " << segment.path << "\n";
+                    CloseSegment();
+                    return;
+                }
+            }
+        }
+
+        void CloseSegment() {
+            if (m_formatCtx) {
+                if (m_headerWritten) av_write_trailer(m_formatCtx);
+                if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE)) avio_closep(&m_formatCtx->pb);
+                avformat_free_context(m_formatCtx);
+            }
+            m_formatCtx = nullptr;
+            m_stream = nullptr;
+            m_headerWritten = false;
+        }
+
+        void Mux(AVPacket* packet) {
+            if (!m_stream) return;
+            if (!m_headerWritten) {
+                if (!(packet->flags & AV_PKT_FLAG_KEY) || !WriteHeader(packet)) return;
+            }
+
+            packet->stream_index = m_stream->index;
+            av_packet_rescale_ts(packet, m_codecTimeBase, m_stream->time_base);
+            if (av_interleaved_write_frame(m_formatCtx, packet) < 0) {
+                std::cerr << "Failed to write recorded packet\n";
+            }
+        }
+
+        // The stream carries SPS/PPS in-band (Annex B) for the receiver, so the
+        // container's codec config is taken from the first keyframe instead.
+        bool WriteHeader(const AVPacket* keyframe) {
+            static const uint8_t startCode[] = { 0, 0, 0, 1 };
+            const uint8_t* data = keyframe->data;
+            int size = keyframe->size;
+            std::vector<uint8_t> extradata;
+
+            int nalStart = -1;
+            auto copyParameterSet = [&](int nalEnd) {
+                if (nalStart < 0 || nalEnd <= nalStart) return;
+                int nalType = data[nalStart] & 0x1F;
+                if (nalType == 7 || nalType == 8) { // SPS, PPS
+                    extradata.insert(extradata.end(), startCode, startCode + 4);
+                    extradata.insert(extradata.end(), data + nalStart, data + nalEnd);
+                }
+            };
+
+            for (int i = 0; i + 2 < size; ++i) {
+                if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+                    copyParameterSet((i > 0 && data[i - 1] == 0) ? i - 1 : i);
+                    nalStart = i + 3;
+                    i += 2;
+                }
+            }
+            copyParameterSet(size);
+
+            if (extradata.empty()) {
+                std::cerr << "Keyframe without SPS/PPS, cannot start recording\n";
+                return false;
+            }
+
+            AVCodecParameters* par = m_stream->codecpar;
+            par->extradata = (uint8_t*)av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!par->extradata) return false;
+            memcpy(par->extradata, extradata.data(), extradata.size());
+            par->extradata_size = (int)extradata.size();
+
+            // fragmented MP4 stays playable if the game crashes mid-recording
+            AVDictionary* opts = nullptr;
+            if (strcmp(m_formatCtx->oformat->name, "mp4") == 0 || strcmp(m_formatCtx->oformat->name, "mov") == 0) {
+                av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+            }
+            int ret = avformat_write_header(m_formatCtx, &opts);
+            av_dict_free(&opts);
+            if (ret < 0) {
+                std::cerr << "Could not write recording header\n";
+                return false;
+            }
+
+            m_headerWritten = true;
+            return true;
+        }
+
+        AVFormatContext* m_formatCtx = nullptr;
+        AVStream* m_stream = nullptr;
+        AVRational m_codecTimeBase = { 1, 1 };
+        bool m_headerWritten = false;
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        std::queue<QueueItem> m_queue;
+        bool m_running = false;
     };
-    
+
 
     std::unique_ptr<FFmpegWriter> m_ffmpegWriter;
-    std::unique_ptr<FFmpegEncoder> m_ffmpegEncoder;
+    std::unique_ptr<SimulcastEncoder> m_simulcastEncoder;
+    std::unique_ptr<StreamRecorder> m_streamRecorder;
 
 
 int startWinsock(void) {
@@ -318,6 +710,60 @@ int startWinsock(void) {
     return WSAStartup(MAKEWORD(2, 0), &wsa);
 }
 
+// Component edits from the imgui windows. Widgets work on copies and queue what changed;
+// Apply writes the queue into the registry once per frame and lists each touched entity
+// once. GetTouched is a hook for systems that react to edits; the engine's systems still
+// walk all entities, here the list is only logged. The buffers keep their capacity.
+class ComponentEdits {
+    public:
+        void SetPosition(vecs::Handle handle, const glm::vec3& position) { m_edits.push_back({ handle, Kind::Position, position, {} }); }
+        void SetRotation(vecs::Handle handle, const glm::mat3& rotation) { m_edits.push_back({ handle, Kind::Rotation, {}, rotation }); }
+        void SetSpotLightColor(vecs::Handle handle, const glm::vec3& color) { m_edits.push_back({ handle, Kind::SpotLightColor, color, {} }); }
+        void SetPointLightColor(vecs::Handle handle, const glm::vec3& color) { m_edits.push_back({ handle, Kind::PointLightColor, color, {} }); }
+        void SetDirectionalLightColor(vecs::Handle handle, const glm::vec3& color) { m_edits.push_back({ handle, Kind::DirectionalLightColor, color, {} }); }
+
+        // Returns the number of touched entities, GetTouched lists them until the next Apply
+        template<typename Registry>
+        size_t Apply(Registry& registry) {
+            m_touched.clear();
+            for (const Edit& edit : m_edits) {
+                switch (edit.kind) {
+                    case Kind::Position: registry.template Get<vve::Position&>(edit.handle)() = edit.vector; break;
+                    case Kind::Rotation: registry.template Get<vve::Rotation&>(edit.handle)() = edit.matrix; break;
+                    case Kind::SpotLightColor: SetColor(registry.template Get<vve::SpotLight&>(edit.handle)().color, edit.vector); break;
+                    case Kind::PointLightColor: SetColor(registry.template Get<vve::PointLight&>(edit.handle)().color, edit.vector); break;
+                    case Kind::DirectionalLightColor: SetColor(registry.template Get<vve::DirectionalLight&>(edit.handle)().color, edit.vector); break;
+                }
+                // a slider drag is a handful of edits per frame, a linear search is enough
+                if (std::find(m_touched.begin(), m_touched.end(), edit.handle) == m_touched.end()) m_touched.push_back(edit.handle);
+            }
+            m_edits.clear();
+            return m_touched.size();
+        }
+
+        const std::vector<vecs::Handle>& GetTouched() const { return m_touched; }
+
+    private:
+        enum class Kind : uint8_t { Position, Rotation, SpotLightColor, PointLightColor, DirectionalLightColor };
+
+        struct Edit {
+            vecs::Handle handle;
+            Kind kind;
+            glm::vec3 vector;
+            glm::mat3 matrix;
+        };
+
+        template<typename Color>
+        static void SetColor(Color& color, const glm::vec3& value) {
+            color.r = value.r;
+            color.g = value.g;
+            color.b = value.b;
+        }
+
+        std::vector<Edit> m_edits;
+        std::vector<vecs::Handle> m_touched;
+};
+
 enum Tags : size_t {
     Tag_Retrievable = 1,
     // Tag_Cypher = 2,
@@ -335,11 +781,27 @@ class MyGame : public vve::System {
                 {this, -10000, "RECORD_NEXT_FRAME", [this](Message& message){ return OnRecordNextFrame(message); }},
                 {this, 0, "FRAME_END", [this](Message& message){ return OnFrameEnd(message); } },
                 {this, 0, "SDL_KEY_DOWN", [this](Message& message){ return OnKeyDown(message);} },
-                {this, 0, "SDL_KEY_REPEAT", [this](Message& message){ return OnKeyDown(message);} }
+                {this, 0, "SDL_KEY_REPEAT", [this](Message& message){ return OnKeyDown(message);} },
+                {this, 0, "SDL_KEY_UP", [this](Message& message){ return OnKeyUp(message);} }
             });
         }
     
-        ~MyGame() = default;
+        ~MyGame() {
+            StopInputListener();
+            CloseSubscribers();
+        }
+
+        // Closes the receivers' sockets, must run before WSACleanup
+        void CloseSubscribers() {
+            for (auto& subscriber : m_subscribers) subscriber.sender.closeSock();
+            m_subscribers.clear();
+        }
+
+        // Joins the listener thread, e.g. before its trace buffer is written out
+        void StopInputListener() {
+            runInputThread = false;
+            if (m_inputListener.joinable()) m_inputListener.join();
+        }
     
     private:
         // --- Constants ---
@@ -357,7 +819,6 @@ class MyGame : public vve::System {
         PlayerState m_playerState = PlayerState::STATIONARY;
         int m_cubeCollected = 0;
         float m_volume = 100.0f;
-        bool m_lastCollisionState = false;
         glm::vec3 m_cameraOffsetLocal = glm::vec3(0.0f, -2.0f, 2.0f);  
     
         // --- Handles ---
@@ -368,13 +829,121 @@ class MyGame : public vve::System {
         vecs::Handle m_buffHandle{};
         // vecs::Handle m_handlePlane{};
         // std::map<vecs::Handle, std::string> m_objects;
-        std::vector<std::string> m_mapGrid;
-        std::vector<vecs::Handle> m_cubeHandles;
         std::vector<vecs::Handle> m_cypherHandles;
+        CollisionGrid m_collisionGrid; // walls of the whole map, cyphers as bodies
+
+        // wall objects only exist for the chunks around the player, see StreamWallChunks
+        std::unordered_map<uint64_t, std::vector<vecs::Handle>> m_wallChunks;
+        int m_chunkSize = 32;
+        int m_playerChunkCol = INT32_MIN;
+        int m_playerChunkRow = INT32_MIN;
+        int m_wallObjectCount = 0; // currently created
+        static constexpr int CHUNK_LOAD_RADIUS = 2;   // in chunks around the player's
+        static constexpr int CHUNK_UNLOAD_RADIUS = 3; // a margin, so walking along a border does not thrash
+        static constexpr float CYPHER_HALF_EXTENT = 0.05f;
+        static constexpr float SPAWN_PLAYER_DISTANCE = 2.0f;
+        static constexpr float SPAWN_SPACING = 1.5f; // between spawned objects
 
         // // --- Streaming Variables ---
-        UDPsend m_UDPsender;
-        FrameLimiter m_frameLimiter{25.0f};
+        // one per receiver, each subscribed to the simulcast layer its reports say it can sustain
+        struct StreamSubscriber {
+            UDPsend sender;
+            int layer = 0;
+            int pendingLayer = 0; // switched to on the next keyframe of that layer
+            int cleanReports = 0;
+            float loss = 0.0f;        // from the last report
+            float receiverFps = 0.0f;
+            double lastReport = 0.0;  // SteadySeconds
+        };
+        std::vector<StreamSubscriber> m_subscribers;
+        std::mutex m_reportMutex;
+        std::vector<std::pair<sockaddr_in6, ReceiverReport>> m_pendingReports; // filled by the listener thread
+        std::thread m_inputListener;
+
+        // --- Remote Input ---
+        struct QueuedInput {
+            InputPacket packet;
+            double arrival; // SteadySeconds() when the listener received it
+        };
+        MPSCQueue<QueuedInput, 256> m_inputQueue; // filled by the listener thread, drained in OnUpdate
+        uint32_t m_lastInputSequence = 0;
+        uint32_t m_lastKeyEvent = 0;
+        uint16_t m_remoteKeys = 0;
+        uint16_t m_remoteTaps = 0; // pressed and released between two ticks, still moves once
+        std::chrono::steady_clock::time_point m_lastInputTime;
+        static constexpr float REMOTE_INPUT_TIMEOUT = 0.5f; // seconds without packets before held keys are released
+
+        // --- Simulation ---
+        // the player moves in fixed ticks of SIM_TICK_SECONDS, see OnUpdate; the key
+        // callbacks only record keys, the registry is written once per frame
+        PlayerSimState m_playerSim;
+        glm::mat3 m_playerBaseRotation{1.0f}; // the model's rotation at yaw 0
+        double m_simAccumulator = 0.0;
+        uint16_t m_localKeys = 0; // held on the game window
+        uint16_t m_localTaps = 0;
+        uint64_t m_droppedTicks = 0;
+        uint32_t m_lastInputTick = 0; // m_playerSim.tick when m_lastInputSequence was applied
+
+        // --- Latency Tracing ---
+        FrameMeta m_pendingTrace{};      // input waiting to be stamped into the next capture
+        static constexpr int TRACE_RING_SIZE = 64;
+        FrameMeta m_frameTraces[TRACE_RING_SIZE] = {}; // by capture pts, encoded packets may come out later
+        std::vector<uint8_t> m_sendBuffer;
+
+        FrameLimiter m_frameLimiter{STREAM_FPS};
+        FrameChangeDetector m_changeDetector;
+        int m_staticFrames = 0;
+        int m_recordingSegment = 0; // the stream recording starts a new file on every resolution change
+        ResolutionPolicy m_resolutionPolicy{FFmpegEncoder::BIT_RATE, STREAM_FPS};
+
+        // --- Stream Statistics ---
+        static constexpr int STATS_INTERVAL_FRAMES = 250;
+        int m_statsFrames = 0;
+        int m_statsSkipped = 0;
+        uint64_t m_statsBytes = 0;
+        double m_statsDetectMs = 0.0;
+        double m_statsEncodeMs = 0.0;
+        double m_statsPyramidMs = 0.0;
+        double m_statsLayerMs[SimulcastEncoder::LAYER_COUNT] = {};
+        int m_statsLayerFrames[SimulcastEncoder::LAYER_COUNT] = {};
+
+        // --- Stream Health ---
+        // rolling over the last seconds, shown in the "Stream Stats" panel and written to METRICS_FILE
+        inline static const std::string METRICS_FILE{ "stream_metrics.txt" };
+        static constexpr double METRICS_INTERVAL = 1.0; // seconds
+        stream_stats::RollingRate m_healthFrames;
+        stream_stats::RollingRate m_healthSkipped;
+        stream_stats::RollingRate m_healthSentBytes;
+        stream_stats::RollingRate m_healthLayerBytes[SimulcastEncoder::LAYER_COUNT];
+        stream_stats::RollingSamples<128> m_healthDetectMs;
+        stream_stats::RollingSamples<128> m_healthEncodeMs;
+        stream_stats::RollingSamples<128> m_healthUiMs; // building the ImGui windows
+        stream_stats::RollingSamples<128> m_healthUiAllocations; // COUNT_ALLOCATIONS only
+        stream_stats::MetricsText m_metrics;
+        stream_stats::MetricsFileWriter m_metricsWriter{ METRICS_FILE };
+        double m_lastMetricsWrite = 0.0;
+
+        // --- Scene Objects List ---
+        // names are copied once when the set of retrievable entities changes, the list only
+        // formats the rows ImGui shows
+        struct SceneListEntry {
+            vecs::Handle handle;
+            std::string name;
+            std::string search; // lower case name
+        };
+        std::vector<SceneListEntry> m_sceneList;
+        std::vector<uint32_t> m_sceneListFiltered; // indices into m_sceneList
+        bool m_sceneListDirty = true;
+        char m_sceneFilter[64] = "";
+
+        // --- Light Editor ---
+        struct LightAngles {
+            bool valid = false;
+            glm::mat3 rotation;  // the rotation the angles belong to
+            glm::vec3 degrees;
+        };
+        std::map<vecs::Handle, LightAngles> m_lightAngles; // spot lights, filled on first sight
+        ComponentEdits m_componentEdits; // applied at the end of OnRecordNextFrame
 
         // --- Helper ---
         vec3_t RandomPosition() {
@@ -389,30 +958,27 @@ class MyGame : public vve::System {
             }
         }
 
+        // away from the player and from earlier spawns when the map has room for it
         vec3_t RandomWalkablePosition() {
-            std::vector<std::pair<int, int>> walkableTiles;
-        
-            for (int row = 0; row < m_mapGrid.size(); ++row) {
-                const auto& line = m_mapGrid[row];
-                for (int col = 0; col < line.length(); ++col) {
-                    if (line[col] != '#') {
-                        walkableTiles.emplace_back(row, col);
-                    }
-                }
+            glm::vec3 playerPos{0.0f};
+            if (m_playerHandle.IsValid()) playerPos = m_registry.Get<vve::Position&>(m_playerHandle)();
+
+            // rand() may only give 15 bits, large maps have more walkable tiles than that
+            auto random = []() { return (unsigned(rand()) << 15) ^ unsigned(rand()); };
+            float x, y;
+            if (!m_collisionGrid.PickWalkable(random, playerPos.x, playerPos.y, SPAWN_PLAYER_DISTANCE, SPAWN_SPACING, x, y)) {
+                return {0.0f, 0.0f, 0.5f}; // fallback
             }
-        
-            if (walkableTiles.empty()) return {0.0f, 0.0f, 0.5f}; // fallback
-        
-            auto [row, col] = walkableTiles[rand() % walkableTiles.size()];
-        
-            float spacing = 1.0f;
-            float x = (float)(col - 5) * spacing;
-            float y = (float)(row - 1) * spacing;
-        
             return { x, y, 0.5f };
         }
         
 
+        // Listed in the "Scene Objects" window
+        void MarkRetrievable(vecs::Handle handle) {
+            m_registry.AddTags(handle, static_cast<size_t>(Tags::Tag_Retrievable));
+            m_sceneListDirty = true;
+        }
+
         void SpawnCyphers(int count) {
             for (int i = 0; i < count; ++i) {
                 vec3_t pos = RandomWalkablePosition();
@@ -423,9 +989,10 @@ class MyGame : public vve::System {
                     vve::Scale{ vec3_t{0.1f} },
                     vve::Name{ cypher_name }
                 );
-                m_registry.AddTags(handle, static_cast<size_t>(Tags::Tag_Retrievable));
+                MarkRetrievable(handle);
 
                 m_cypherHandles.push_back(handle);
+                m_collisionGrid.AddBody(pos.x, pos.y, CYPHER_HALF_EXTENT);
         
                 // m_engine.SendMsg(MsgSceneCreate{
                 //     vve::ObjectHandle(handle), vve::ParentHandle{}, vve::Filename{cypher_obj}, aiProcess_FlipWindingOrder
@@ -433,109 +1000,280 @@ class MyGame : public vve::System {
             }
         }
 
+        // A text map or a binary .tmap (see map_convert.cpp). Only the collision grid is
+        // built for the whole map, wall objects are streamed in by StreamWallChunks.
         void LoadMapAndSpawnWalls(const std::string& mapFilePath) {
-            std::ifstream mapFile(mapFilePath);
-            if (!mapFile.is_open()) {
+            auto loadStart = std::chrono::steady_clock::now();
+            if (!LoadMapGrid(mapFilePath, m_collisionGrid, m_chunkSize)) {
                 std::cerr << "Failed to open map file: " << mapFilePath << std::endl;
                 return;
             }
-        
-            std::string line;
-            int row = 0;
-            int cube_num = 0;
-            m_mapGrid.clear();
-        
-            while (std::getline(mapFile, line)) {
-                m_mapGrid.push_back(line);
-                for (int col = 0; col < line.length(); ++col) {
-                    if (line[col] == '#') { // '#' means place a wall cube
-                        // Each cube is at grid (col, row), but we might want to scale it (spacing between cubes)
-                        float spacing = 1.0f; // How far apart cubes are
-                        float x = (float)(col-5) * spacing;
-                        float y = (float)(row-1) * spacing; // -row so Y axis goes downward
-                        // std::cout << x << std::endl;
-                        // std::cout << y << std::endl;
-                        // std::cout << "spawned cube" << std::endl;
 
-        
-                        // Insert cube
-                        cube_num ++;
-                        std::string cube_name = "Cube " + std::to_string(cube_num);
-                        vecs::Handle handle = m_registry.Insert(
-                            vve::Position{ {x, y, 0.5f} },
-                            vve::Rotation{ mat3_t{1.0f} },
-                            vve::Scale{ vec3_t{1.0f} },
-                            vve::Name{ cube_name }
-                        );
-                        m_registry.AddTags(handle, static_cast<size_t>(Tags::Tag_Retrievable));
-        
-                        m_cubeHandles.push_back(handle);
-        
-                        m_engine.SendMsg(MsgSceneCreate{
-                            vve::ObjectHandle(handle),
-                            vve::ParentHandle{},
-                            vve::Filename{cube_obj},
-                            aiProcess_FlipWindingOrder
-                        });
+            for (auto& [key, handles] : m_wallChunks) DestroyWallObjects(handles);
+            m_wallChunks.clear();
+            m_playerChunkCol = m_playerChunkRow = INT32_MIN;
+            glm::vec3 playerPos{0.0f};
+            if (m_playerHandle.IsValid()) playerPos = m_registry.Get<vve::Position&>(m_playerHandle)();
+            StreamWallChunks(playerPos);
+
+            double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+            LOG_INFO("[Map] %s: %dx%d tiles, %zu chunks of %d around the player with %d wall objects, loaded in %.1f ms",
+                     mapFilePath.c_str(), m_collisionGrid.GetColumns(), m_collisionGrid.GetRows(), m_wallChunks.size(),
+                     m_chunkSize, m_wallObjectCount, loadMs);
+        }
+
+        // Creates the wall objects of the chunks near the player and destroys those of chunks
+        // it left behind; does nothing until the player enters another chunk
+        void StreamWallChunks(const glm::vec3& playerPos) {
+            int col, row;
+            m_collisionGrid.WorldToTile(playerPos.x, playerPos.y, col, row);
+            auto floorDiv = [](int value, int divisor) { return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor); };
+            int chunkCol = floorDiv(col, m_chunkSize);
+            int chunkRow = floorDiv(row, m_chunkSize);
+            if (chunkCol == m_playerChunkCol && chunkRow == m_playerChunkRow) return;
+            m_playerChunkCol = chunkCol;
+            m_playerChunkRow = chunkRow;
+
+            int chunkColumns = (m_collisionGrid.GetColumns() + m_chunkSize - 1) / m_chunkSize;
+            int chunkRows = (m_collisionGrid.GetRows() + m_chunkSize - 1) / m_chunkSize;
+            for (int cr = std::max(chunkRow - CHUNK_LOAD_RADIUS, 0); cr <= std::min(chunkRow + CHUNK_LOAD_RADIUS, chunkRows - 1); ++cr) {
+                for (int cc = std::max(chunkCol - CHUNK_LOAD_RADIUS, 0); cc <= std::min(chunkCol + CHUNK_LOAD_RADIUS, chunkColumns - 1); ++cc) {
+                    uint64_t key = (uint64_t(uint32_t(cr)) << 32) | uint32_t(cc);
+                    if (m_wallChunks.count(key)) continue;
+                    m_wallChunks[key] = SpawnWallChunk(cc, cr);
+                }
+            }
+
+            for (auto it = m_wallChunks.begin(); it != m_wallChunks.end();) {
+                int cc = int(uint32_t(it->first)), cr = int(uint32_t(it->first >> 32));
+                if (std::abs(cc - chunkCol) > CHUNK_UNLOAD_RADIUS || std::abs(cr - chunkRow) > CHUNK_UNLOAD_RADIUS) {
+                    DestroyWallObjects(it->second);
+                    it = m_wallChunks.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            LOG_DEBUG("[Map] player in chunk %d,%d, %zu chunks with %d wall objects", chunkCol, chunkRow, m_wallChunks.size(), m_wallObjectCount);
+        }
+
+        // One scaled cube per merged run of '#' tiles instead of one cube per tile, so
+        // entities and draw calls grow with the wall runs; collision uses the tiles.
+        std::vector<vecs::Handle> SpawnWallChunk(int chunkCol, int chunkRow) {
+            std::vector<vecs::Handle> handles;
+            int col = chunkCol * m_chunkSize, row = chunkRow * m_chunkSize;
+            for (auto& box : m_collisionGrid.MergeWalls(col, row, col + m_chunkSize, row + m_chunkSize)) {
+                float x, y, width, height;
+                m_collisionGrid.WallBoxBounds(box, x, y, width, height);
+
+                m_wallObjectCount++;
+                std::string cube_name = "Wall " + std::to_string(chunkCol) + "," + std::to_string(chunkRow) + " " + std::to_string(handles.size() + 1);
+                vecs::Handle handle = m_registry.Insert(
+                    vve::Position{ {x, y, 0.5f} },
+                    vve::Rotation{ mat3_t{1.0f} },
+                    vve::Scale{ vec3_t{width, height, 1.0f} },
+                    vve::Name{ cube_name }
+                );
+                MarkRetrievable(handle);
+                handles.push_back(handle);
+
+                m_engine.SendMsg(MsgSceneCreate{
+                    vve::ObjectHandle(handle),
+                    vve::ParentHandle{},
+                    vve::Filename{cube_obj},
+                    aiProcess_FlipWindingOrder
+                });
+            }
+            return handles;
+        }
+
+        void DestroyWallObjects(const std::vector<vecs::Handle>& handles) {
+            for (auto& handle : handles) {
+                m_engine.SendMsg(MsgObjectDestroy{ vve::ObjectHandle(handle) });
+                m_wallObjectCount--;
+            }
+            m_sceneListDirty = true;
+        }
+
+        // Runs on the render thread, the listener only queues the reports
+        void ProcessReceiverReports() {
+            std::vector<std::pair<sockaddr_in6, ReceiverReport>> reports;
+            {
+                std::lock_guard<std::mutex> lock(m_reportMutex);
+                reports.swap(m_pendingReports);
+            }
+
+            double now = SteadySeconds();
+            for (auto& [from, report] : reports) {
+                sockaddr_in6 videoAddr = from;
+                videoAddr.sin6_port = htons(report.video_port);
+
+                auto it = std::find_if(m_subscribers.begin(), m_subscribers.end(), [&](const StreamSubscriber& subscriber) {
+                    return subscriber.sender.addr.sin6_port == videoAddr.sin6_port &&
+                           memcmp(&subscriber.sender.addr.sin6_addr, &videoAddr.sin6_addr, sizeof(in6_addr)) == 0;
+                });
+                if (it == m_subscribers.end()) {
+                    m_subscribers.emplace_back();
+                    it = std::prev(m_subscribers.end());
+                    it->sender.init(videoAddr);
+                    it->lastReport = now;
+                    // it cannot decode anything before the next IDR frame of its layer
+                    if (m_simulcastEncoder) m_simulcastEncoder->GetLayer(it->layer).RequestKeyFrame();
+                    LOG_INFO("[Stream] new receiver on port %u", (unsigned)report.video_port);
+                }
+
+                // reordered frames can make received exceed expected for one interval
+                float loss = report.expected_packets
+                    ? std::max(0.0f, 1.0f - float(report.received_packets) / float(report.expected_packets)) : 0.0f;
+                it->loss = loss;
+                it->lastReport = now;
+                it->receiverFps = report.frame_rate;
+
+                if (loss > LAYER_DOWN_LOSS && it->layer + 1 < SimulcastEncoder::LAYER_COUNT) {
+                    it->pendingLayer = it->layer + 1;
+                    it->cleanReports = 0;
+                } else if (loss < LAYER_UP_LOSS) {
+                    if (++it->cleanReports >= LAYER_UP_REPORTS && it->layer > 0) {
+                        it->pendingLayer = it->layer - 1;
+                        it->cleanReports = 0;
                     }
+                } else {
+                    it->cleanReports = 0;
                 }
-                row++;
             }
-        
-            mapFile.close();
+
+            // a receiver that was closed or lost its connection stops reporting
+            auto silent = std::remove_if(m_subscribers.begin(), m_subscribers.end(), [&](StreamSubscriber& subscriber) {
+                if (now - subscriber.lastReport <= SUBSCRIBER_TIMEOUT) return false;
+                LOG_INFO("[Stream] receiver on port %u timed out", (unsigned)ntohs(subscriber.sender.addr.sin6_port));
+                subscriber.sender.closeSock(); // UDPsend does not close its socket itself
+                return true;
+            });
+            m_subscribers.erase(silent, m_subscribers.end());
         }
 
-        bool CheckCollision(const glm::vec3& proposedPos) {
-            float playerRadius = 0.3f; // adjust if you want tighter/looser collision
-            glm::vec3 cubeHalfExtents(0.5f, 0.5f, 0.5f); // assuming 1x1x1 cubes
-            glm::vec3 cypherHalfExtents(0.05f, 0.05f, 0.05f); // assuming 1x1x1 cubes
-        
-            for (auto& cubeHandle : m_cubeHandles) {
-                if (!cubeHandle.IsValid()) continue;
-        
-                auto& cubePos = m_registry.Get<vve::Position&>(cubeHandle)();
-        
-                float minX = cubePos.x - cubeHalfExtents.x;
-                float maxX = cubePos.x + cubeHalfExtents.x;
-                float minY = cubePos.y - cubeHalfExtents.y;
-                float maxY = cubePos.y + cubeHalfExtents.y;
-        
-                float closestX = glm::clamp(proposedPos.x, minX, maxX);
-                float closestY = glm::clamp(proposedPos.y, minY, maxY);
-        
-                float dx = proposedPos.x - closestX;
-                float dy = proposedPos.y - closestY;
-        
-                if (dx * dx + dy * dy < playerRadius * playerRadius) {
-                    return true; // collision detected
+        // Rolling stream health, refreshed every frame
+        void DrawStreamStats() {
+            double now = SteadySeconds();
+            ImGui::SetNextWindowPos(ImVec2(320, 10), ImGuiCond_Once);
+            ImGui::SetNextWindowSize(ImVec2(300, 280), ImGuiCond_Once);
+            ImGui::SetNextWindowCollapsed(true, ImGuiCond_Once);
+            ImGui::Begin("Stream Stats");
+
+            ImGui::SeparatorText("Sender");
+            ImGui::Text("capture: %.1f fps, %.1f skipped/s", m_healthFrames.PerSecond(now), m_healthSkipped.PerSecond(now));
+            ImGui::Text("sent: %.1f kbps", m_healthSentBytes.PerSecond(now) * 8.0 / 1000.0);
+            for (int i = 0; i < SimulcastEncoder::LAYER_COUNT; ++i) {
+                ImGui::Text("layer %d: %.1f kbps", i, m_healthLayerBytes[i].PerSecond(now) * 8.0 / 1000.0);
+            }
+            ImGui::Text("detect: p50 %.2f ms, p99 %.2f ms", m_healthDetectMs.Percentile(0.5), m_healthDetectMs.Percentile(0.99));
+            ImGui::Text("encode: p50 %.2f ms, p99 %.2f ms", m_healthEncodeMs.Percentile(0.5), m_healthEncodeMs.Percentile(0.99));
+            ImGui::Text("ui: p50 %.2f ms, p99 %.2f ms", m_healthUiMs.Percentile(0.5), m_healthUiMs.Percentile(0.99));
+        #ifdef COUNT_ALLOCATIONS
+            ImGui::Text("ui allocations: p50 %.0f, max %.0f", m_healthUiAllocations.Percentile(0.5), m_healthUiAllocations.Percentile(1.0));
+        #endif
+
+            ImGui::SeparatorText("Queues");
+            ImGui::Text("input: %zu", m_inputQueue.Size());
+            ImGui::Text("sim: tick %u (%llu dropped)", m_playerSim.tick, (unsigned long long)m_droppedTicks);
+            if (m_streamRecorder) ImGui::Text("recorder: %zu", m_streamRecorder->GetQueueDepth());
+            if (m_ffmpegWriter) ImGui::Text("raw writer: %zu (%llu dropped)", m_ffmpegWriter->GetQueueDepth(),
+                                            (unsigned long long)m_ffmpegWriter->GetDroppedFrames());
+
+            ImGui::SeparatorText("Receivers");
+            for (auto& subscriber : m_subscribers) {
+                ImGui::Text("port %u: layer %d, loss %.1f%%, %.1f fps", (unsigned)ntohs(subscriber.sender.addr.sin6_port),
+                            subscriber.layer, subscriber.loss * 100.0f, subscriber.receiverFps);
+            }
+            ImGui::End();
+        }
+
+        // The retrievable entities, filtered by name. Only the visible rows are laid out and
+        // read from the registry; names are cached until entities are added or destroyed.
+        void DrawSceneObjects() {
+            bool refilter = false;
+            if (m_sceneListDirty) {
+                m_sceneList.clear();
+                for (auto [handle, name] : m_registry.GetView<vecs::Handle, vve::Name>(std::vector<size_t>{Tags::Tag_Retrievable})) {
+                    SceneListEntry entry{ handle, name, name };
+                    std::transform(entry.search.begin(), entry.search.end(), entry.search.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                    m_sceneList.push_back(std::move(entry));
                 }
+                m_sceneListDirty = false;
+                refilter = true;
             }
-            
-            for (auto& cypherHandle : m_cypherHandles) {
-                if (!cypherHandle.IsValid()) continue;
-        
-                auto& cypherPos = m_registry.Get<vve::Position&>(cypherHandle)();
-        
-                float minX = cypherPos.x - cypherHalfExtents.x;
-                float maxX = cypherPos.x + cypherHalfExtents.x;
-                float minY = cypherPos.y - cypherHalfExtents.y;
-                float maxY = cypherPos.y + cypherHalfExtents.y;
-        
-                float closestX = glm::clamp(proposedPos.x, minX, maxX);
-                float closestY = glm::clamp(proposedPos.y, minY, maxY);
-        
-                float dx = proposedPos.x - closestX;
-                float dy = proposedPos.y - closestY;
-        
-                if (dx * dx + dy * dy < playerRadius * playerRadius) {
-                    return true; // collision detected
+            if (ImGui::InputTextWithHint("##filter", "filter", m_sceneFilter, sizeof(m_sceneFilter))) refilter = true;
+
+            if (refilter) {
+                std::string filter = m_sceneFilter;
+                std::transform(filter.begin(), filter.end(), filter.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                m_sceneListFiltered.clear();
+                for (uint32_t i = 0; i < m_sceneList.size(); ++i) {
+                    if (filter.empty() || m_sceneList[i].search.find(filter) != std::string::npos) m_sceneListFiltered.push_back(i);
                 }
             }
-        
-            return false; // no collision
+            ImGui::Text("%zu of %zu objects", m_sceneListFiltered.size(), m_sceneList.size());
+            ImGui::Separator();
+
+            ImGui::BeginChild("##objects");
+            ImGuiListClipper clipper;
+            clipper.Begin((int)m_sceneListFiltered.size());
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    const SceneListEntry& entry = m_sceneList[m_sceneListFiltered[i]];
+                    if (!m_registry.Exists(entry.handle)) {
+                        ImGui::TextDisabled("%s", entry.name.c_str()); // destroyed, dropped on the next rebuild
+                        continue;
+                    }
+                    const auto& pos = m_registry.Get<vve::Position&>(entry.handle)();
+                    ImGui::Text("%s  (%.2f, %.2f, %.2f)", entry.name.c_str(), pos.x, pos.y, pos.z);
+                }
+            }
+            ImGui::EndChild();
         }
-    
+
+        // Same values as the panel, for scraping
+        void WriteMetrics(double now) {
+            char name[96];
+            m_metrics.Clear();
+            m_metrics.Add("game_capture_fps", m_healthFrames.PerSecond(now));
+            m_metrics.Add("game_skipped_fps", m_healthSkipped.PerSecond(now));
+            m_metrics.Add("game_sent_kbps", m_healthSentBytes.PerSecond(now) * 8.0 / 1000.0);
+            for (int i = 0; i < SimulcastEncoder::LAYER_COUNT; ++i) {
+                snprintf(name, sizeof(name), "game_layer_kbps{layer=\"%d\"}", i);
+                m_metrics.Add(name, m_healthLayerBytes[i].PerSecond(now) * 8.0 / 1000.0);
+            }
+            m_metrics.Add("game_detect_ms_p50", m_healthDetectMs.Percentile(0.5));
+            m_metrics.Add("game_detect_ms_p99", m_healthDetectMs.Percentile(0.99));
+            m_metrics.Add("game_encode_ms_p50", m_healthEncodeMs.Percentile(0.5));
+            m_metrics.Add("game_encode_ms_p99", m_healthEncodeMs.Percentile(0.99));
+            m_metrics.Add("game_ui_ms_p50", m_healthUiMs.Percentile(0.5));
+            m_metrics.Add("game_ui_ms_p99", m_healthUiMs.Percentile(0.99));
+        #ifdef COUNT_ALLOCATIONS
+            m_metrics.Add("game_ui_allocations_p50", m_healthUiAllocations.Percentile(0.5));
+            m_metrics.Add("game_ui_allocations_max", m_healthUiAllocations.Percentile(1.0));
+        #endif
+            m_metrics.Add("game_input_queue_depth", (double)m_inputQueue.Size());
+            m_metrics.Add("game_sim_dropped_ticks", (double)m_droppedTicks);
+            if (m_streamRecorder) m_metrics.Add("game_recorder_queue_depth", (double)m_streamRecorder->GetQueueDepth());
+            if (m_ffmpegWriter) {
+                m_metrics.Add("game_raw_writer_queue_depth", (double)m_ffmpegWriter->GetQueueDepth());
+                m_metrics.Add("game_raw_writer_dropped", (double)m_ffmpegWriter->GetDroppedFrames());
+            }
+            for (auto& subscriber : m_subscribers) {
+                unsigned port = ntohs(subscriber.sender.addr.sin6_port);
+                snprintf(name, sizeof(name), "game_receiver_layer{port=\"%u\"}", port);
+                m_metrics.Add(name, subscriber.layer);
+                snprintf(name, sizeof(name), "game_receiver_loss{port=\"%u\"}", port);
+                m_metrics.Add(name, subscriber.loss);
+                snprintf(name, sizeof(name), "game_receiver_fps{port=\"%u\"}", port);
+                m_metrics.Add(name, subscriber.receiverFps);
+            }
+
+            m_metricsWriter.Publish(m_metrics); // fopen and rename happen on the writer thread
+        }
+
         void StartInputListener() {
+            TRACE_THREAD_NAME("input listener");
             SOCKET sock = socket(AF_INET6, SOCK_DGRAM, 0); // IPv6
             if (sock == INVALID_SOCKET) {
                 std::cerr << "Failed to create socket\n";
@@ -549,41 +1287,35 @@ class MyGame : public vve::System {
 
             if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
                 std::cerr << "Bind failed\n";
+                closesocket(sock);
                 return;
             }
 
-
+            // wake up regularly to see runInputThread, StopInputListener joins this thread
+            DWORD timeoutMs = 100;
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
 
             char buffer[64];
-            std::cout << "yessss" << std::endl;
+            LOG_INFO("Input listener running on port %d", LISTEN_PORT);
             while (runInputThread.load()) {
                 sockaddr_in6 sender;
                 int len = sizeof(sender);
                 int recvLen = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (sockaddr*)&sender, &len);
-                if (recvLen > 0) {
-                    std::cout << "yayyyy this ran!" << std::endl;
-                    buffer[recvLen] = '\0';
-                    uint32_t code;
-                    float dt;
-
-                    if (sscanf(buffer, "%u:%f", &code, &dt) == 2) {  
-                        std::cout << "[Receiver Input] Key code: " << code << " | dt: " << dt << "s\n";
-
-                        SDL_Event e{};
-                        e.type = SDL_KEYDOWN;
-                        e.key.type = SDL_KEYDOWN;
-                        e.key.timestamp = SDL_GetTicks();
-                        e.key.windowID = 0; // 0 = default window
-                        e.key.state = SDL_PRESSED;
-                        e.key.repeat = 0;
-                        e.key.keysym.scancode = static_cast<SDL_Scancode>(code); // set this too
-                        e.key.keysym.sym = SDL_GetKeyFromScancode(static_cast<SDL_Scancode>(code));
-                        e.key.keysym.mod = KMOD_NONE;
-                        SDL_Scancode key = static_cast<SDL_Scancode>(code);
-                        this->HandleRemoteKey(key, dt);
-
-                        // SDL_PushEvent(&e);
-                        std::cout << "Pushed SDL_KEYDOWN for keycode: " << code << "\n";
+                if (recvLen == sizeof(ReceiverReport) && buffer[0] == PACKET_RECEIVER_REPORT) {
+                    ReceiverReport report;
+                    memcpy(&report, buffer, sizeof(report));
+                    std::lock_guard<std::mutex> lock(m_reportMutex);
+                    m_pendingReports.emplace_back(sender, report);
+                } else if (recvLen == sizeof(InputPacket) && buffer[0] == PACKET_INPUT) {
+                    QueuedInput queued;
+                    memcpy(&queued.packet, buffer, sizeof(queued.packet));
+                    queued.arrival = SteadySeconds();
+                    const InputPacket& input = queued.packet;
+                    LOG_DEBUG_LIMITED("[Receiver Input] key state %u, seq %u", (unsigned)input.key_state, (unsigned)input.sequence);
+
+                    // applied on the game thread in OnUpdate, never here
+                    if (!m_inputQueue.TryPush(queued)) {
+                        LOG_WARN_LIMITED("Input queue full, dropping input %u", (unsigned)input.sequence);
                     }
                 } else {
                     std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -594,44 +1326,105 @@ class MyGame : public vve::System {
         }
 
 
-        void HandleRemoteKey(SDL_Scancode key, float dt) {
-            auto& playerPos = m_registry.Get<vve::Position&>(m_playerHandle)();
-            auto& playerRot = m_registry.Get<vve::Rotation&>(m_playerHandle)();
+        void ApplyRemoteInput(const QueuedInput& queued) {
+            const InputPacket& input = queued.packet;
+            if (input.sequence <= m_lastInputSequence) {
+                if (m_lastInputSequence - input.sequence < 1000) return; // duplicate or reordered
+                m_lastKeyEvent = 0; // a restarted receiver counts from 1 again
+            }
+            m_lastInputSequence = input.sequence;
+            m_lastInputTick = m_playerSim.tick;
+            m_lastInputTime = std::chrono::steady_clock::now();
+            m_remoteKeys = input.key_state;
+
+            // replay key edges we have not seen yet, oldest first
+            for (int i = INPUT_EVENT_HISTORY - 1; i >= 0; --i) {
+                if (input.event_sequence < (uint32_t)i + 1) continue;
+                uint32_t eventSequence = input.event_sequence - i;
+                if (eventSequence <= m_lastKeyEvent) continue;
+
+                m_lastKeyEvent = eventSequence;
+                uint8_t event = input.events[i];
+                if (event & 0x80) m_remoteTaps |= (1u << (event & 0x7F));
+                TraceInput(queued);
+            }
+            if (input.flags & INPUT_MOUSE) TraceInput(queued);
+
+            if ((input.flags & INPUT_MOUSE) && input.mouse_dx != 0) {
+                TurnPlayer(m_playerSim, input.mouse_dx);
+            }
+        }
 
-            float moveSpeed = dt * 5.0f;
-            float rotSpeed = glm::radians(90.0f) * dt;
+        // Inputs with a visible effect are traced into the next captured frame
+        void TraceInput(const QueuedInput& queued) {
+            m_pendingTrace.input_sequence = queued.packet.sequence;
+            m_pendingTrace.input_timestamp = queued.packet.timestamp;
+            m_pendingTrace.input_arrival = queued.arrival;
+        }
 
-            glm::vec3 moveDir{0.0f};
-            glm::vec3 forward = playerRot * glm::vec3(0.0f, 0.0f, 1.0f);
-            glm::vec3 right   = playerRot * glm::vec3(1.0f, 0.0f, 0.0f);
+        // Trace of the capture an encoded packet belongs to, only its pts once the ring moved on
+        FrameMeta GetFrameTrace(int64_t pts) const {
+            FrameMeta meta = m_frameTraces[pts % TRACE_RING_SIZE];
+            if (meta.pts != pts) {
+                meta = FrameMeta{};
+                meta.pts = pts;
+            }
+            return meta;
+        }
 
-            switch (key) {
-                case SDL_SCANCODE_W: moveDir += forward; break;
-                case SDL_SCANCODE_S: moveDir -= forward; break;
-                case SDL_SCANCODE_A: moveDir += right; break;
-                case SDL_SCANCODE_D: moveDir -= right; break;
-                case SDL_SCANCODE_LEFT:
-                    playerRot = glm::mat3(glm::rotate(glm::mat4(playerRot), rotSpeed, glm::vec3(0.0f, 1.0f, 0.0f)));
-                    break;
-                case SDL_SCANCODE_RIGHT:
-                    playerRot = glm::mat3(glm::rotate(glm::mat4(playerRot), -rotSpeed, glm::vec3(0.0f, 1.0f, 0.0f)));
-                    break;
-                case SDL_SCANCODE_ESCAPE:
-                    m_engine.Stop();
-                    break;
+        void SendFrame(StreamSubscriber& subscriber, const FrameMeta& meta, const uint8_t* data, int size) {
+            m_sendBuffer.resize(sizeof(FrameMeta) + size);
+            memcpy(m_sendBuffer.data(), &meta, sizeof(FrameMeta));
+            memcpy(m_sendBuffer.data() + sizeof(FrameMeta), data, size);
+            subscriber.sender.send_fragmented((char*)m_sendBuffer.data(), (int)m_sendBuffer.size());
+        }
+
+        // One fixed step: inputs that arrived so far are applied at the tick boundary, then
+        // the held keys of both the game window and the receiver move the player once
+        void SimulationTick() {
+            QueuedInput input;
+            while (m_inputQueue.TryPop(input)) {
+                ApplyRemoteInput(input);
             }
 
-            if (glm::length(moveDir) > 0.0f) {
-                glm::vec3 proposedPos = playerPos + glm::normalize(moveDir) * moveSpeed;
-                if (!CheckCollision(proposedPos)) {
-                    playerPos = proposedPos;
-                    m_engine.SendMsg(vve::System::MsgPlaySound{ vve::Filename{"../escape/assets/sounds/bump.wav"}, 1, 100 });
-                }
+            // the receiver repeats its key state while keys are held, silence means it is gone
+            if (m_remoteKeys && std::chrono::duration<float>(std::chrono::steady_clock::now() - m_lastInputTime).count() > REMOTE_INPUT_TIMEOUT) {
+                m_remoteKeys = 0;
+            }
+            uint16_t keys = m_remoteKeys | m_remoteTaps | m_localKeys | m_localTaps;
+            m_remoteTaps = 0;
+            m_localTaps = 0;
+
+            float x = m_playerSim.x, y = m_playerSim.y;
+            if (StepPlayer(m_playerSim, keys, (float)SIM_TICK_SECONDS, m_collisionGrid)) { // only if new collision!
+                m_engine.SendMsg(MsgPlaySound{ vve::Filename{"../escape/assets/sounds/bump.wav"}, 1, 100 });
+                LOG_DEBUG_LIMITED("boink");
+            }
+
+            // blocked unless it got at least a tenth of the way, sliding counts as moving
+            float step = SIM_MOVE_SPEED * (float)SIM_TICK_SECONDS;
+            glm::vec2 moved{ m_playerSim.x - x, m_playerSim.y - y };
+            m_playerState = glm::dot(moved, moved) > 0.01f * step * step ? PlayerState::MOVING : PlayerState::STATIONARY;
+        }
+
+        // The authoritative state for the receivers' prediction, a few dozen bytes per update
+        void SendPlayerState() {
+            PlayerStatePacket packet{};
+            packet.tick = m_playerSim.tick;
+            packet.input_sequence = m_lastInputSequence;
+            packet.ticks_since_input = m_playerSim.tick - m_lastInputTick;
+            packet.x = m_playerSim.x;
+            packet.y = m_playerSim.y;
+            packet.z = m_playerSim.z;
+            packet.yaw = m_playerSim.yaw;
+            for (auto& subscriber : m_subscribers) {
+                subscriber.sender.send_message(MESSAGE_PLAYER_STATE, packet.tick, &packet, sizeof(packet));
             }
         }
 
         // --- Callbacks ---
         bool OnLoadLevel(Message message) {
+            TRACE_THREAD_NAME("engine");
             auto msg = message.template GetData<vve::System::MsgLoadLevel>();
             // std::cout << "Loading level: " << msg.m_level << std::endl;
     
@@ -651,6 +1444,8 @@ class MyGame : public vve::System {
     
             // initialise player
             glm::mat3 p_rotation = glm::mat3( glm::rotate( glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0,0,1)) * glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1,0,0) ) );
+            m_playerBaseRotation = p_rotation;
+            m_playerSim = PlayerSimState{};
             
             m_playerHandle = m_registry.Insert(
                 vve::Position{ {0, 0, 0} },
@@ -658,7 +1453,7 @@ class MyGame : public vve::System {
                 vve::Scale{ vec3_t{1.0f} },
                 vve::Name{ "Player" }
             );
-            m_registry.AddTags(m_playerHandle, static_cast<size_t>(Tags::Tag_Retrievable));
+            MarkRetrievable(m_playerHandle);
             
             m_engine.SendMsg(MsgSceneCreate{
                 vve::ObjectHandle(m_playerHandle), vve::ParentHandle{}, vve::Filename{player_obj}
@@ -670,7 +1465,7 @@ class MyGame : public vve::System {
                 vve::ObjectHandle{m_cameraNodeHandle},
                 vve::ParentHandle{m_playerHandle}
             });
-            m_registry.AddTags(m_cameraNodeHandle, static_cast<size_t>(Tags::Tag_Retrievable));
+            MarkRetrievable(m_cameraNodeHandle);
             
             m_registry.Get<vve::Position&>(m_cameraNodeHandle)() = glm::vec3(0.0f, 1.0f, -1.0f);
             
@@ -686,15 +1481,20 @@ class MyGame : public vve::System {
             // initialise cypher machines
             SpawnCyphers(3); 
 
+            // registry only, nothing is rendered for them
+            for (int i = 0; i < SCENE_LIST_TEST_ENTITIES; ++i) {
+                MarkRetrievable(m_registry.Insert(
+                    vve::Position{ RandomPosition() },
+                    vve::Name{ "Test " + std::to_string(i + 1) }
+                ));
+            }
+
             // initialise bgm
             m_engine.SendMsg(vve::System::MsgPlaySound{ vve::Filename{"../escape/assets/sounds/stardew.wav"}, 2, 80 });
             m_engine.SendMsg(vve::System::MsgSetVolume{ static_cast<int>(m_volume) });
     
-            std::thread listener(&MyGame::StartInputListener, this);
-            listener.detach();
-            
-            // initialise UDP sender
-            m_UDPsender.init("::1", 9999);
+            // receivers (and netsim in front of one) subscribe with their first report
+            if (!m_inputListener.joinable()) m_inputListener = std::thread(&MyGame::StartInputListener, this);
             // m_registry.Print();
 
             return false;
@@ -702,8 +1502,27 @@ class MyGame : public vve::System {
     
         bool OnUpdate(Message& message) {
             auto msg = message.GetData<vve::System::MsgUpdate>();
-            auto& playerPos = m_registry.Get<vve::Position&>(m_playerHandle)();
-            auto& playerRot = m_registry.Get<vve::Rotation&>(m_playerHandle)();
+
+            // a fixed number of ticks per second whatever the frame rate, and at most
+            // SIM_MAX_TICKS_PER_UPDATE per frame, after a longer stall the rest is dropped
+            m_simAccumulator += msg.m_dt;
+            int ticks = 0;
+            while (m_simAccumulator >= SIM_TICK_SECONDS && ticks < SIM_MAX_TICKS_PER_UPDATE) {
+                SimulationTick();
+                m_simAccumulator -= SIM_TICK_SECONDS;
+                ticks++;
+            }
+            if (m_simAccumulator >= SIM_TICK_SECONDS) {
+                m_droppedTicks += (uint64_t)(m_simAccumulator / SIM_TICK_SECONDS);
+                m_simAccumulator = std::fmod(m_simAccumulator, SIM_TICK_SECONDS);
+            }
+
+            if (ticks > 0 && m_playerHandle.IsValid()) {
+                m_registry.Get<vve::Position&>(m_playerHandle)() = glm::vec3(m_playerSim.x, m_playerSim.y, m_playerSim.z);
+                m_registry.Get<vve::Rotation&>(m_playerHandle)() = glm::mat3(glm::rotate(glm::mat4(m_playerBaseRotation), m_playerSim.yaw, glm::vec3(0.0f, 1.0f, 0.0f)));
+                SendPlayerState();
+            }
+            if (m_playerHandle.IsValid()) StreamWallChunks(m_registry.Get<vve::Position&>(m_playerHandle)());
         
             return false;
         }
@@ -721,22 +1540,13 @@ class MyGame : public vve::System {
             }
 
 
+            double uiStart = SteadySeconds();
+            uint64_t uiAllocations = ThreadAllocations();
             ImGui::SetNextWindowPos(ImVec2(10, 10));
             ImGui::SetNextWindowSize(ImVec2(300, 540));
             ImGui::SetNextWindowCollapsed(!showSceneObjects, ImGuiCond_Once);
-            ImGui::Begin("Scene Objects");
-            if (ImGui::IsWindowCollapsed()) showSceneObjects = false;
-            else showSceneObjects = true;
-        
-            auto retrievables = m_registry.GetView<vve::Name, vve::Position>(std::vector<size_t>{Tags::Tag_Retrievable});
-            for (auto [name, pos] : retrievables) {
-                std::string objName = name;
-                auto& objPos = pos;
-                ImGui::Text("%s", objName.c_str());
-                ImGui::Text("  Position: (%.2f, %.2f, %.2f)", objPos().x, objPos().y, objPos().z);
-                ImGui::Separator();
-            }
-            
+            showSceneObjects = ImGui::Begin("Scene Objects"); // false while collapsed
+            if (showSceneObjects) DrawSceneObjects();
             ImGui::End();
 
             ImGui::SetNextWindowPos(ImVec2(10, 30));
@@ -755,89 +1565,83 @@ class MyGame : public vve::System {
 
             ImGui::SeparatorText("Light Settings");
             if (ImGui::BeginTabBar("Light Settings")) {
+                // IDs come from the light's name on the ID stack, the views hand out references,
+                // so a frame without edits builds no strings; edits go through m_componentEdits
                 if (ImGui::BeginTabItem("Spot Light")) {
                     for (auto [handle, name, position, rotation, spotLight] : m_registry.GetView<
-                    vecs::Handle, vve::Name, vve::Position, vve::Rotation, vve::SpotLight&>()) {
-
-                        auto& s = spotLight();
-
-                        auto& rawPos = position();
-                        auto& pointPos = m_registry.Get<vve::Position&>(handle)();
-                        float pos[3] = { rawPos.x, rawPos.y, rawPos.z };
-
-                        if (ImGui::SliderFloat3(("Position##" + std::string(name)).c_str(), pos, -50.0f, 50.0f)) {
-                            pointPos.x = pos[0];
-                            pointPos.y = pos[1];
-                            pointPos.z = pos[2];
-                        }
-                        
-                        ImGui::Text("");
-
-                        auto& rawRot = rotation();
-                        auto& pointRot = m_registry.Get<vve::Rotation&>(handle)();
-
-                        glm::vec3 eulerAngles = glm::eulerAngles(glm::quat_cast(rawRot)); // radians
-
-                        float degrees[3] = {
-                            glm::degrees(eulerAngles.x),
-                            glm::degrees(eulerAngles.y),
-                            glm::degrees(eulerAngles.z)
-                        };
-
-                        std::string rotLabel = "Rotation##" + static_cast<std::string>(name);
-                        if (ImGui::SliderFloat3(rotLabel.c_str(), degrees, -180.0f, 180.0f)) {
-                            glm::vec3 newAngles = glm::radians(glm::vec3(degrees[0], degrees[1], degrees[2]));
-                            glm::quat q = glm::quat(newAngles);
-                            pointRot = glm::mat3_cast(q); 
-                        }
-                        
-                        ImGui::Text("");
-
-                        float color[4] = { s.color.r, s.color.g, s.color.b, 1.0f };
-                        std::string label = "Color##" + static_cast<std::string>(name);
-                        if (ImGui::ColorPicker4(label.c_str(), color)) {
-                            s.color.r = color[0]; s.color.g = color[1]; s.color.b = color[2];
+                    vecs::Handle, vve::Name&, vve::Position&, vve::Rotation&, vve::SpotLight&>()) {
+                        ImGui::PushID(name().c_str());
+                        if (ImGui::TreeNode(name().c_str())) {
+                            const auto& s = spotLight();
+
+                            glm::vec3 pos = position();
+                            if (ImGui::SliderFloat3("Position", glm::value_ptr(pos), -50.0f, 50.0f)) {
+                                m_componentEdits.SetPosition(handle, pos);
+                            }
+                            ImGui::Text("");
+
+                            // the angles are kept while the rotation is ours, a round trip through
+                            // the quaternion every frame would make them jump at the poles
+                            auto& angles = m_lightAngles[handle];
+                            if (!angles.valid || angles.rotation != rotation()) {
+                                angles.degrees = glm::degrees(glm::eulerAngles(glm::quat_cast(rotation())));
+                                angles.rotation = rotation();
+                                angles.valid = true;
+                            }
+                            if (ImGui::SliderFloat3("Rotation", glm::value_ptr(angles.degrees), -180.0f, 180.0f)) {
+                                angles.rotation = glm::mat3_cast(glm::quat(glm::radians(angles.degrees)));
+                                m_componentEdits.SetRotation(handle, angles.rotation);
+                            }
+                            ImGui::Text("");
+
+                            glm::vec3 color{ s.color.r, s.color.g, s.color.b };
+                            if (ImGui::ColorPicker3("Color", glm::value_ptr(color))) {
+                                m_componentEdits.SetSpotLightColor(handle, color);
+                            }
+                            ImGui::TreePop();
                         }
+                        ImGui::PopID();
                     }
                     ImGui::EndTabItem();
                 }
 
                 if (ImGui::BeginTabItem("Point Light")) {
                     for (auto [handle, name, position, pointLight] : m_registry.GetView<
-                    vecs::Handle, vve::Name, vve::Position, vve::PointLight&>()) {
-                        auto& p = pointLight();
-
-                        auto& rawPos = position();
-                        auto& pointPos = m_registry.Get<vve::Position&>(handle)();
-                        float pos[3] = { rawPos.x, rawPos.y, rawPos.z };
-
-                        if (ImGui::SliderFloat3(("Position##" + std::string(name)).c_str(), pos, -50.0f, 50.0f)) {
-                            pointPos.x = pos[0];
-                            pointPos.y = pos[1];
-                            pointPos.z = pos[2];
-                        }
-                        
-                        ImGui::Text("");
-
-                        float color[4] = { p.color.r, p.color.g, p.color.b, 1.0f };
-                        std::string label = "Color##" + static_cast<std::string>(name);
-                        if (ImGui::ColorPicker4(label.c_str(), color)) {
-                            p.color.r = color[0]; p.color.g = color[1]; p.color.b = color[2];
+                    vecs::Handle, vve::Name&, vve::Position&, vve::PointLight&>()) {
+                        ImGui::PushID(name().c_str());
+                        if (ImGui::TreeNode(name().c_str())) {
+                            const auto& p = pointLight();
+
+                            glm::vec3 pos = position();
+                            if (ImGui::SliderFloat3("Position", glm::value_ptr(pos), -50.0f, 50.0f)) {
+                                m_componentEdits.SetPosition(handle, pos);
+                            }
+                            ImGui::Text("");
+
+                            glm::vec3 color{ p.color.r, p.color.g, p.color.b };
+                            if (ImGui::ColorPicker3("Color", glm::value_ptr(color))) {
+                                m_componentEdits.SetPointLightColor(handle, color);
+                            }
+                            ImGui::TreePop();
                         }
+                        ImGui::PopID();
                     }
                     ImGui::EndTabItem();
                 }
 
                 if (ImGui::BeginTabItem("Directional Light")) {
                     for (auto [handle, name, position, dirLight] : m_registry.GetView<
-                    vecs::Handle, vve::Name, vve::Position, vve::DirectionalLight&>()) {
-                        auto& d = dirLight();
-                        
-                        float color[4] = { d.color.r, d.color.g, d.color.b, 1.0f };
-                        std::string label = "Color##" + static_cast<std::string>(name);
-                        if (ImGui::ColorPicker4(label.c_str(), color)) {
-                            d.color.r = color[0]; d.color.g = color[1]; d.color.b = color[2];
+                    vecs::Handle, vve::Name&, vve::Position&, vve::DirectionalLight&>()) {
+                        ImGui::PushID(name().c_str());
+                        if (ImGui::TreeNode(name().c_str())) {
+                            const auto& d = dirLight();
+                            glm::vec3 color{ d.color.r, d.color.g, d.color.b };
+                            if (ImGui::ColorPicker3("Color", glm::value_ptr(color))) {
+                                m_componentEdits.SetDirectionalLightColor(handle, color);
+                            }
+                            ImGui::TreePop();
                         }
+                        ImGui::PopID();
                     }
                     ImGui::EndTabItem();
                 }
@@ -846,6 +1650,11 @@ class MyGame : public vve::System {
             }
 
             ImGui::End();
+
+            DrawStreamStats();
+            if (size_t touched = m_componentEdits.Apply(m_registry)) LOG_DEBUG("[UI] edited %zu entities", touched);
+            m_healthUiMs.Add((SteadySeconds() - uiStart) * 1000.0);
+            m_healthUiAllocations.Add((double)(ThreadAllocations() - uiAllocations));
             // if (showControls) {
                 
             // } else {
@@ -928,6 +1737,7 @@ class MyGame : public vve::System {
         }
 
         bool OnFrameEnd(Message& message) {
+            TRACE_SCOPE("OnFrameEnd");
             auto [rhandle, renderer] = vve::Renderer::GetState(m_registry);
             auto [whandle, window] = vve::Window::GetState(m_registry, "");
 
@@ -943,6 +1753,9 @@ class MyGame : public vve::System {
 
             uint8_t* dataImage = new uint8_t[imageSize];
 
+            double captureStart = SteadySeconds();
+            {
+            TRACE_SCOPE("ImgCopyImageToHost");
             vh::ImgCopyImageToHost(
                 renderer().m_device,
                 renderer().m_vmaAllocator,
@@ -958,23 +1771,146 @@ class MyGame : public vve::System {
                 imageSize,
                 2, 1, 0, 3
             );
-
-            if (!m_ffmpegWriter) {
-                m_ffmpegWriter = std::make_unique<FFmpegWriter>(extent.width, extent.height, "C:/Users/aanny/source/repos/fork/escape/videos/recording.h264");
             }
+            double captureEnd = SteadySeconds();
 
-            m_ffmpegWriter->WriteFrame(dataImage);
+            if (RECORD_MODE == RecordMode::RawPipe) {
+                if (!m_ffmpegWriter) {
+                    m_ffmpegWriter = std::make_unique<FFmpegWriter>(extent.width, extent.height, "C:/Users/aanny/source/repos/fork/escape/videos/recording.h264");
+                }
+                m_ffmpegWriter->WriteFrame(dataImage);
+            }
 
             // After copying image to dataImage
-            if (!m_ffmpegEncoder) {
-                m_ffmpegEncoder = std::make_unique<FFmpegEncoder>(extent.width, extent.height);
+            if (!m_simulcastEncoder) {
+                m_simulcastEncoder = std::make_unique<SimulcastEncoder>(extent.width, extent.height, (int)STREAM_FPS);
+            }
+            FFmpegEncoder& baseLayer = m_simulcastEncoder->GetLayer(0);
+
+            if (RECORD_MODE == RecordMode::Stream && !m_streamRecorder) {
+                m_streamRecorder = std::make_unique<StreamRecorder>(RecordingPath(m_recordingSegment), baseLayer.GetCodecContext());
             }
+
+            ProcessReceiverReports();
+
+            // remember when this capture happened, its packet may only come out of the encoder later
+            int64_t capturePts = baseLayer.GetNextPts();
+            FrameMeta& trace = m_frameTraces[capturePts % TRACE_RING_SIZE];
+            trace = m_pendingTrace;
+            trace.pts = capturePts;
+            trace.capture_start = captureStart;
+            trace.capture_end = captureEnd;
+            m_pendingTrace = FrameMeta{};
             
-            auto [encodedData, encodedSize] = m_ffmpegEncoder->EncodeFrame(dataImage);
-            if (encodedData && encodedSize > 0) {
-                // std::cout << "Sending H264 frame: " << encodedSize << " bytes\n";
-                m_UDPsender.send_fragmented((char*)encodedData, encodedSize);
-                m_ffmpegEncoder->FreePacket();
+            auto detectStart = std::chrono::steady_clock::now();
+            DirtyRegion dirty = m_changeDetector.Update(dataImage, extent.width, extent.height);
+            auto encodeStart = std::chrono::steady_clock::now();
+            double detectMs = std::chrono::duration<double, std::milli>(encodeStart - detectStart).count();
+            m_statsDetectMs += detectMs;
+            m_healthDetectMs.Add(detectMs);
+            m_healthFrames.Add(1.0, captureEnd);
+
+            m_staticFrames = dirty.changed ? 0 : m_staticFrames + 1;
+            // the encoder runs without delay, so the last changed frame is already out; the few
+            // unchanged frames after it still sharpen the picture. Once a second an IDR frame
+            // is sent so a receiver that lost a packet (or joined late) recovers
+            bool idle = m_staticFrames > STATIC_FRAMES_BEFORE_SKIP;
+            bool skip = idle && m_staticFrames % (int)STREAM_FPS != 0;
+            if (idle && !skip) m_simulcastEncoder->RequestKeyFrame();
+
+            if (skip) {
+                m_simulcastEncoder->SkipFrame();
+                m_statsSkipped++;
+                m_healthSkipped.Add(1.0, captureEnd);
+            } else {
+                // only layers somebody watches (or records) are encoded
+                unsigned layerMask = m_streamRecorder ? 1u : 0u;
+                for (auto& subscriber : m_subscribers) {
+                    layerMask |= (1u << subscriber.layer) | (1u << subscriber.pendingLayer);
+                }
+
+                bool partial = dirty.changed && dirty.fraction < ROI_MAX_FRACTION;
+                m_simulcastEncoder->Encode(dataImage, partial ? &dirty : nullptr, layerMask);
+                double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encodeStart).count();
+                m_statsEncodeMs += encodeMs;
+                m_statsPyramidMs += m_simulcastEncoder->GetPyramidMs();
+                m_healthEncodeMs.Add(encodeMs);
+                for (int i = 0; i < SimulcastEncoder::LAYER_COUNT; ++i) {
+                    if (!(layerMask & (1u << i))) continue;
+                    m_statsLayerMs[i] += m_simulcastEncoder->GetEncodeMs(i);
+                    m_statsLayerFrames[i]++;
+                    m_healthLayerBytes[i].Add(m_simulcastEncoder->GetResult(i).second, captureEnd);
+                }
+
+                for (auto& subscriber : m_subscribers) {
+                    if (subscriber.pendingLayer != subscriber.layer) {
+                        auto [data, size] = m_simulcastEncoder->GetResult(subscriber.pendingLayer);
+                        if (data && m_simulcastEncoder->GetLayer(subscriber.pendingLayer).IsKeyFrame()) {
+                            subscriber.layer = subscriber.pendingLayer;
+                        }
+                    }
+
+                    auto [encodedData, encodedSize] = m_simulcastEncoder->GetResult(subscriber.layer);
+                    if (encodedData && encodedSize > 0) {
+                        FrameMeta meta = GetFrameTrace(m_simulcastEncoder->GetLayer(subscriber.layer).GetPacket()->pts);
+                        meta.encode_end = SteadySeconds();
+
+                        // std::cout << "Sending H264 frame: " << encodedSize << " bytes\n";
+                        SendFrame(subscriber, meta, encodedData, encodedSize);
+                        m_statsBytes += encodedSize;
+                        m_healthSentBytes.Add(encodedSize, captureEnd);
+                    }
+                }
+
+                auto [baseData, baseSize] = m_simulcastEncoder->GetResult(0);
+                if (baseData) {
+                    if (m_streamRecorder) m_streamRecorder->WritePacket(baseLayer.GetPacket());
+                    m_resolutionPolicy.OnFrameEncoded(baseSize, m_simulcastEncoder->GetEncodeMs(0));
+                }
+                m_simulcastEncoder->FreePackets();
+
+                if (m_resolutionPolicy.Evaluate(baseLayer.GetWidth(), baseLayer.GetHeight())) {
+                    // what the old codecs still hold goes out before they are reopened
+                    m_simulcastEncoder->SetBaseScale(m_resolutionPolicy.GetScale(), [&](int layer, const AVPacket* packet) {
+                        for (auto& subscriber : m_subscribers) {
+                            if (subscriber.layer != layer) continue;
+                            FrameMeta meta = GetFrameTrace(packet->pts);
+                            meta.encode_end = SteadySeconds();
+                            SendFrame(subscriber, meta, packet->data, packet->size);
+                            m_statsBytes += packet->size;
+                        }
+                        if (layer == 0 && m_streamRecorder) m_streamRecorder->WritePacket(packet);
+                    });
+                    // the container keeps the size and SPS of its first keyframe, so a new size gets a new file
+                    if (m_streamRecorder) {
+                        m_streamRecorder->StartSegment(RecordingPath(++m_recordingSegment), baseLayer.GetCodecContext());
+                    }
+                    LOG_INFO("[Stream] output resolution %dx%d", baseLayer.GetWidth(), baseLayer.GetHeight());
+                }
+            }
+
+            if (++m_statsFrames == STATS_INTERVAL_FRAMES) {
+                int encoded = m_statsFrames - m_statsSkipped;
+                char layers[128] = "";
+                int length = 0;
+                for (int i = 0; i < SimulcastEncoder::LAYER_COUNT; ++i) {
+                    length += snprintf(layers + length, sizeof(layers) - length, ", layer %d %.2f ms", i,
+                                       m_statsLayerFrames[i] ? m_statsLayerMs[i] / m_statsLayerFrames[i] : 0.0);
+                    m_statsLayerMs[i] = 0.0;
+                    m_statsLayerFrames[i] = 0;
+                }
+                LOG_INFO("[Stream] %d encoded, %d skipped, %.1f kbps, detect %.2f ms, encode %.2f ms (pyramid %.2f ms%s)",
+                         encoded, m_statsSkipped, m_statsBytes * 8 * STREAM_FPS / m_statsFrames / 1000.0,
+                         m_statsDetectMs / m_statsFrames, encoded ? m_statsEncodeMs / encoded : 0.0,
+                         encoded ? m_statsPyramidMs / encoded : 0.0, layers);
+                m_statsFrames = m_statsSkipped = 0;
+                m_statsBytes = 0;
+                m_statsDetectMs = m_statsEncodeMs = m_statsPyramidMs = 0.0;
+            }
+
+            if (captureEnd - m_lastMetricsWrite >= METRICS_INTERVAL) {
+                WriteMetrics(captureEnd);
+                m_lastMetricsWrite = captureEnd;
             }
             
             // std::vector<uint8_t> encoded = m_udpSender.compress(dataImage, extent.width, extent.height);
@@ -988,77 +1924,35 @@ class MyGame : public vve::System {
 
         }
         
+        // Movement keys of the game window, as bits of the simulation's keys
+        static InputKey ScancodeToInputKey(int key) {
+            switch (key) {
+                case SDL_SCANCODE_W: return KEY_W;
+                case SDL_SCANCODE_S: return KEY_S;
+                case SDL_SCANCODE_A: return KEY_A;
+                case SDL_SCANCODE_D: return KEY_D;
+                case SDL_SCANCODE_LEFT: return KEY_LEFT;
+                case SDL_SCANCODE_RIGHT: return KEY_RIGHT;
+                default: return KEY_COUNT;
+            }
+        }
+
+        // Keys are only recorded here, SimulationTick moves the player
         bool OnKeyDown(Message& message) {
-            GetCamera();
-        
-            // Get component references
-            auto [pn, rn, sn, LtoPn] = m_registry.template Get<vve::Position&, vve::Rotation&, vve::Scale&, vve::LocalToParentMatrix>(m_cameraNodeHandle);
-            auto [pc, rc, sc, LtoPc] = m_registry.template Get<vve::Position&, vve::Rotation&, vve::Scale&, vve::LocalToParentMatrix>(m_cameraHandle);
-    
-            auto& playerPos = m_registry.Get<vve::Position&>(m_playerHandle)();
-            auto& playerRot = m_registry.Get<vve::Rotation&>(m_playerHandle)();
-        
-            int key; 
-            float dt;
+            int key;
             if (message.HasType<MsgKeyDown>()) {
-                auto msg = message.template GetData<MsgKeyDown>();
-                key = msg.m_key;
-                dt = msg.m_dt;
-                
+                key = message.template GetData<MsgKeyDown>().m_key;
             } else {
-                auto msg = message.template GetData<MsgKeyRepeat>();
-                key = msg.m_key;
-                dt = msg.m_dt;
+                key = message.template GetData<MsgKeyRepeat>().m_key;
             }
-        
-            float moveSpeed = dt * 5.0f;
-            float rotSpeed = glm::radians(90.0f) * dt; // 90 degrees/sec
-        
-            glm::vec3 moveDir{0.0f};
-        
-            // Define local movement directions
-            glm::vec3 localForward = glm::vec3(0.0f, 0.0f, 1.0f); // +Z
-            glm::vec3 localRight   = glm::vec3(1.0f, 0.0f, 0.0f); // +X
-        
-            // Convert local directions into world directions
-            glm::vec3 forward = playerRot * localForward;
-            glm::vec3 right   = playerRot * localRight;
-            // glm::vec3 c_forward = camNodeRot * localForward;
-            // glm::vec3 c_right   = camNodeRot * localRight;
-    
-            // for Camera
-            glm::vec3 translate(0.0f);
-            glm::vec3 axis1(1.0f), axis2(1.0f);
-            float angle1 = 0.0f, angle2 = 0.0f;
-            int dx = 0, dy = 0;
-            
-    
+
+            InputKey inputKey = ScancodeToInputKey(key);
+            if (inputKey != KEY_COUNT) {
+                m_localKeys |= (1u << inputKey);
+                m_localTaps |= (1u << inputKey); // a press shorter than a tick still moves once
+            }
+
             switch (key) {
-                case SDL_SCANCODE_W:
-                    moveDir += forward;
-                    break;
-                case SDL_SCANCODE_S:
-                    moveDir -= forward;
-                    break;
-                case SDL_SCANCODE_A:
-                    moveDir += right;
-                    break;
-                case SDL_SCANCODE_D:
-                    moveDir -= right;
-                    break;
-            
-                case SDL_SCANCODE_LEFT: {
-                    glm::vec3 rotAxis = glm::vec3(0.0f, 1.0f, 0.0f); // rotate around Z
-                    playerRot = glm::mat3(glm::rotate(glm::mat4(playerRot), rotSpeed, rotAxis));
-                    dx = -1;
-                    break;
-                }
-                case SDL_SCANCODE_RIGHT: {
-                    glm::vec3 rotAxis = glm::vec3(0.0f, 1.0f, 0.0f); // rotate around Z
-                    playerRot = glm::mat3(glm::rotate(glm::mat4(playerRot), -rotSpeed, rotAxis));
-                    dx = 1;
-                    break;
-                }
                 case SDL_SCANCODE_SPACE: {
                     if (message.HasType<MsgKeyRepeat>()) break;
     
@@ -1086,32 +1980,25 @@ class MyGame : public vve::System {
     
                 case SDL_SCANCODE_ESCAPE: {
                     const char* shutdownMsg = "__SHUTDOWN__";
-                    m_UDPsender.send_fragmented((char*)shutdownMsg, strlen(shutdownMsg));
+                    FrameMeta shutdownMeta{};
+                    shutdownMeta.pts = -1;
+                    for (auto& subscriber : m_subscribers) {
+                        SendFrame(subscriber, shutdownMeta, (const uint8_t*)shutdownMsg, (int)strlen(shutdownMsg));
+                    }
                     m_engine.Stop();
                     break;
                 }                
             }
-    
-            if (glm::length(moveDir) > 0.0f) {
-                moveDir = glm::normalize(moveDir) * moveSpeed;
-                glm::vec3 proposedPos = playerPos + moveDir;
-                m_playerState = PlayerState::MOVING;
-                bool collision = CheckCollision(proposedPos);
-                if (!collision) {
-                    playerPos = proposedPos;
-                    m_lastCollisionState = false; // no collision now
-                } else {
-                    m_playerState = PlayerState::STATIONARY;
-                    if (!m_lastCollisionState) { // only if new collision!
-                        m_engine.SendMsg(MsgPlaySound{ vve::Filename{"assets/sounds/bump.wav"}, 1, 100 });
-                        std::cout << "boink" << std::endl;
-                    }
-                    m_lastCollisionState = true; // remember that we are colliding now
-                }
-            }
             
             return true;
         }
+
+        bool OnKeyUp(Message& message) {
+            auto msg = message.template GetData<MsgKeyUp>();
+            InputKey inputKey = ScancodeToInputKey(msg.m_key);
+            if (inputKey != KEY_COUNT) m_localKeys &= ~(1u << inputKey);
+            return false;
+        }
     };
 
 int main() {
@@ -1119,6 +2006,16 @@ int main() {
     vve::Engine engine("My Engine", VK_MAKE_VERSION(1, 3, 0)) ;
     MyGame mygui{engine};  
     engine.Run();
+    // every traced thread is joined before its ring buffer is read
+    mygui.StopInputListener();
+    mygui.CloseSubscribers();
+    m_streamRecorder.reset(); // flush queued packets and finish the container
+    if (m_ffmpegWriter) {
+        std::cout << "Raw recording: " << m_ffmpegWriter->GetDroppedFrames() << " frames dropped, queue high-water mark "
+                  << m_ffmpegWriter->GetHighWaterMark() << "\n";
+        m_ffmpegWriter.reset();
+    }
+    TRACE_WRITE("trace_game.json", "game");
     WSACleanup();
     return 0;
 }
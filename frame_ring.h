@@ -0,0 +1,110 @@
+#pragma once
+
+// Fixed ring of frame-sized slots between the render thread and one writer thread. The
+// game's raw recording feeds ffmpeg through it; ring_check.cpp runs it against a slow
+// sink without the engine or ffmpeg.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "stream_trace.h"
+
+class FrameRing {
+    public:
+        // Drop: discard the new frame when the ring is full, the producer never waits on the sink.
+        // Block: wait for a free slot, every frame reaches the sink.
+        enum class OverflowPolicy { Drop, Block };
+
+        // Called on the writer thread with one frame at a time
+        using Sink = std::function<void(const uint8_t* data, size_t size)>;
+
+        FrameRing(size_t frameSize, Sink sink, OverflowPolicy policy = OverflowPolicy::Drop, size_t ringSize = 8,
+                  const char* threadName = "frame ring writer")
+            : m_sink(std::move(sink)), m_policy(policy), m_threadName(threadName),
+              m_ring(std::max<size_t>(ringSize, 1), std::vector<uint8_t>(frameSize))
+        {
+            m_running = true;
+            m_thread = std::thread(&FrameRing::Run, this);
+        }
+
+        // Writes every queued frame to the sink before returning
+        ~FrameRing() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+            m_frameReady.notify_one();
+            if (m_thread.joinable()) m_thread.join();
+        }
+
+        // Copies the frame into the ring, returns false if it was dropped
+        bool WriteFrame(const uint8_t* frameData) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_count == m_ring.size()) {
+                if (m_policy == OverflowPolicy::Drop) {
+                    m_droppedFrames++;
+                    return false;
+                }
+                m_slotFree.wait(lock, [this] { return m_count < m_ring.size(); });
+            }
+
+            size_t slot = (m_head + m_count) % m_ring.size();
+            memcpy(m_ring[slot].data(), frameData, m_ring[slot].size());
+            m_count++;
+            m_highWaterMark = std::max(m_highWaterMark.load(), m_count);
+            m_frameReady.notify_one();
+            return true;
+        }
+
+        uint64_t GetDroppedFrames() const { return m_droppedFrames.load(); }
+        size_t GetHighWaterMark() const { return m_highWaterMark.load(); }
+        size_t GetCapacity() const { return m_ring.size(); }
+
+        size_t GetQueueDepth() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_count;
+        }
+
+    private:
+        void Run() {
+            TRACE_THREAD_NAME(m_threadName);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_frameReady.wait(lock, [this] { return m_count > 0 || !m_running; });
+                if (m_count == 0) break;
+
+                // the slot stays owned by the writer until the write is done
+                std::vector<uint8_t>& frame = m_ring[m_head];
+                lock.unlock();
+
+                m_sink(frame.data(), frame.size());
+
+                lock.lock();
+                m_head = (m_head + 1) % m_ring.size();
+                m_count--;
+                m_slotFree.notify_one();
+            }
+        }
+
+        Sink m_sink;
+        OverflowPolicy m_policy;
+        const char* m_threadName;
+        std::vector<std::vector<uint8_t>> m_ring;
+        size_t m_head = 0;
+        size_t m_count = 0;
+        std::atomic<uint64_t> m_droppedFrames{0};
+        std::atomic<size_t> m_highWaterMark{0};
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_frameReady;
+        std::condition_variable m_slotFree;
+        bool m_running = false;
+};
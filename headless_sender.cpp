@@ -0,0 +1,236 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+#include "stream_sender.h"
+#include "stream_stats.h"
+
+// Streams procedural frames through the game's encoder and UDP sender, without the
+// engine, a GPU or a window. Together with `receiver --headless` this measures
+// throughput and latency of the streaming path on any machine, repeatably.
+//
+// Every frame is marked as traced (input_sequence != 0, input time = capture start), so
+// the receiver's latency breakdown covers capture to present for all frames.
+
+// A gradient scrolling by `motion` pixels per frame with boxes moving across it. Detail
+// adds static per-pixel texture, noise changes every pixel in every frame; both make the
+// encoder spend more bits, like a busy scene.
+class SyntheticFrameSource {
+public:
+    static constexpr int BOX_COUNT = 8;
+
+    SyntheticFrameSource(int width, int height, float motion, float detail, float noise, uint32_t seed)
+        : width(width), height(height), motion(motion), detail(detail), noise(noise), seed(seed),
+          rgba(size_t(width) * height * 4) {}
+
+    const uint8_t* next() {
+        int offset = static_cast<int>(frame * motion);
+        int detailAmplitude = static_cast<int>(detail * 64.0f);
+        int noiseAmplitude = static_cast<int>(noise * 64.0f);
+
+        for (int y = 0; y < height; ++y) {
+            uint8_t* row = rgba.data() + size_t(y) * width * 4;
+            for (int x = 0; x < width; ++x) {
+                int r = ((x + offset) * 255 / width) & 0xFF;
+                int g = (y * 255 / height) & 0xFF;
+                int b = ((x + y + offset) >> 2) & 0xFF;
+                int grain = 0;
+                if (detailAmplitude) grain += int(hash(x, y, 0) % (2 * detailAmplitude + 1)) - detailAmplitude;
+                if (noiseAmplitude) grain += int(hash(x, y, frame + 1) % (2 * noiseAmplitude + 1)) - noiseAmplitude;
+                row[x * 4 + 0] = clamp(r + grain);
+                row[x * 4 + 1] = clamp(g + grain);
+                row[x * 4 + 2] = clamp(b + grain);
+                row[x * 4 + 3] = 255;
+            }
+        }
+
+        for (int i = 0; i < BOX_COUNT; ++i) drawBox(i, offset);
+        frame++;
+        return rgba.data();
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    uint32_t hash(uint32_t x, uint32_t y, uint32_t z) const {
+        uint32_t h = seed ^ (x * 0x8DA6B343u) ^ (y * 0xD8163841u) ^ (z * 0xCB1AB31Fu);
+        h ^= h >> 13;
+        h *= 0x5BD1E995u;
+        return h ^ (h >> 15);
+    }
+
+    static uint8_t clamp(int value) { return static_cast<uint8_t>(std::min(255, std::max(0, value))); }
+
+    // bounces between the frame edges, speed and colour from the box index
+    void drawBox(int index, int offset) {
+        int size = std::max(8, height / 8);
+        int speed = 1 + index % 3;
+        int spanX = std::max(1, width - size), spanY = std::max(1, height - size);
+        int px = (int(hash(index, 0, 0) % spanX) + offset * speed) % (2 * spanX);
+        int py = (int(hash(index, 1, 0) % spanY) + offset * speed / 2) % (2 * spanY);
+        if (px >= spanX) px = 2 * spanX - px - 1;
+        if (py >= spanY) py = 2 * spanY - py - 1;
+
+        uint32_t colour = hash(index, 2, 0);
+        for (int y = py; y < py + size && y < height; ++y) {
+            uint8_t* pixel = rgba.data() + (size_t(y) * width + px) * 4;
+            for (int x = px; x < px + size && x < width; ++x, pixel += 4) {
+                pixel[0] = colour & 0xFF;
+                pixel[1] = (colour >> 8) & 0xFF;
+                pixel[2] = (colour >> 16) & 0xFF;
+            }
+        }
+    }
+
+    int width;
+    int height;
+    float motion;
+    float detail;
+    float noise;
+    uint32_t seed;
+    uint32_t frame = 0;
+    std::vector<uint8_t> rgba;
+};
+
+int startWinsock() {
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa);
+}
+
+void printUsage() {
+    std::cerr << "usage: headless_sender [options]\n"
+                 "  --host ADDR       receiver address (::1)\n"
+                 "  --port N          receiver video port (9999)\n"
+                 "  --size WxH        frame size (1280x720)\n"
+                 "  --fps N           frame rate (25)\n"
+                 "  --bitrate N       encoder bit rate in bit/s (400000)\n"
+                 "  --seconds N       run time (30)\n"
+                 "  --motion PX       scroll speed in pixels per frame (4)\n"
+                 "  --detail F        static texture, 0..1 (0.2)\n"
+                 "  --noise F         changing noise, 0..1 (0)\n"
+                 "  --seed N          pattern seed (1)\n"
+                 "  --unpaced         encode and send as fast as possible\n";
+}
+
+int main(int argc, char** argv) {
+    std::string host = "::1";
+    int port = 9999;
+    int width = 1280, height = 720;
+    int fps = 25;
+    int64_t bitRate = FFmpegEncoder::BIT_RATE;
+    double seconds = 30.0;
+    float motion = 4.0f, detail = 0.2f, noise = 0.0f;
+    uint32_t seed = 1;
+    bool paced = true;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // consumes the next argument
+        auto next = [&]() { return ++i < argc ? argv[i] : "0"; };
+
+        if (arg == "--host") {
+            host = next();
+        } else if (arg == "--port") {
+            port = atoi(next());
+        } else if (arg == "--size") {
+            if (sscanf(next(), "%dx%d", &width, &height) != 2) width = height = 0;
+        } else if (arg == "--fps") {
+            fps = atoi(next());
+        } else if (arg == "--bitrate") {
+            bitRate = atoll(next());
+        } else if (arg == "--seconds") {
+            seconds = atof(next());
+        } else if (arg == "--motion") {
+            motion = static_cast<float>(atof(next()));
+        } else if (arg == "--detail") {
+            detail = static_cast<float>(atof(next()));
+        } else if (arg == "--noise") {
+            noise = static_cast<float>(atof(next()));
+        } else if (arg == "--seed") {
+            seed = static_cast<uint32_t>(atoll(next()));
+        } else if (arg == "--unpaced") {
+            paced = false;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (width < 16 || height < 16 || fps <= 0) {
+        printUsage();
+        return -1;
+    }
+
+    if (startWinsock() != 0) return -1;
+
+    UDPsend sender;
+    sender.init(host.c_str(), port);
+    FFmpegEncoder encoder(width, height, fps, bitRate);
+    FrameLimiter limiter(static_cast<float>(fps));
+    SyntheticFrameSource source(width, height, motion, detail, noise, seed);
+
+    // by capture pts, B-frames come out of the encoder one frame later
+    static constexpr int TRACE_RING_SIZE = 64;
+    FrameMeta traces[TRACE_RING_SIZE] = {};
+    std::vector<uint8_t> sendBuffer;
+
+    stream_stats::RollingSamples<4096> generateMs, encodeMs, sendMs;
+    uint64_t frames = 0, packets = 0, bytes = 0;
+
+    std::cout << "headless sender: " << width << "x" << height << " @ " << fps << " fps, "
+              << bitRate / 1000 << " kbps to [" << host << "]:" << port << (paced ? "" : ", unpaced") << "\n";
+
+    double start = SteadySeconds();
+    while (SteadySeconds() - start < seconds) {
+        int64_t pts = encoder.GetNextPts();
+        FrameMeta& trace = traces[pts % TRACE_RING_SIZE];
+        trace = FrameMeta{};
+        trace.pts = pts;
+        trace.input_sequence = static_cast<uint32_t>(frames + 1);
+        trace.capture_start = trace.input_timestamp = trace.input_arrival = SteadySeconds();
+
+        const uint8_t* rgba = source.next();
+        trace.capture_end = SteadySeconds();
+
+        auto [data, size] = encoder.EncodeFrame(rgba);
+        double encodeEnd = SteadySeconds();
+        generateMs.Add((trace.capture_end - trace.capture_start) * 1000.0);
+        encodeMs.Add((encodeEnd - trace.capture_end) * 1000.0);
+        frames++;
+
+        if (data && size > 0) {
+            int64_t packetPts = encoder.GetPacket()->pts;
+            FrameMeta meta = traces[packetPts % TRACE_RING_SIZE];
+            if (meta.pts != packetPts) {
+                meta = FrameMeta{};
+                meta.pts = packetPts;
+            }
+            meta.encode_end = encodeEnd;
+
+            sendBuffer.resize(sizeof(FrameMeta) + size);
+            memcpy(sendBuffer.data(), &meta, sizeof(FrameMeta));
+            memcpy(sendBuffer.data() + sizeof(FrameMeta), data, size);
+            int fragments = sender.send_fragmented((char*)sendBuffer.data(), (int)sendBuffer.size());
+            sendMs.Add((SteadySeconds() - encodeEnd) * 1000.0);
+            if (fragments > 0) packets += fragments;
+            bytes += sendBuffer.size();
+        }
+        encoder.FreePacket();
+
+        if (paced) limiter.Wait();
+    }
+    double elapsed = SteadySeconds() - start;
+
+    printf("%llu frames in %.1f s: %.1f fps, %.1f kbps, %llu packets\n", (unsigned long long)frames, elapsed,
+           frames / elapsed, bytes * 8.0 / elapsed / 1000.0, (unsigned long long)packets);
+    printf("generate p50 %.2f ms, encode p50 %.2f ms / p99 %.2f ms, send p50 %.2f ms / p99 %.2f ms\n",
+           generateMs.Percentile(0.5), encodeMs.Percentile(0.5), encodeMs.Percentile(0.99),
+           sendMs.Percentile(0.5), sendMs.Percentile(0.99));
+
+    sender.closeSock();
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tile_map.h"
+
+// Converts the game's text maps to the binary tile map format (tile_map.h), and writes
+// generated room maps of any size for testing the chunk streaming:
+//
+//   g++ -std=c++17 -O2 map_convert.cpp -o map_convert
+//   map_convert escape/assets/maps/map.txt escape/assets/maps/map.tmap
+//   map_convert --rooms 4096 12 big.tmap
+
+void printUsage() {
+    std::cerr << "usage: map_convert [options] INPUT.txt OUTPUT.tmap\n"
+                 "       map_convert [options] --rooms SIZE ROOM OUTPUT.tmap\n"
+                 "  --chunk N         tiles per chunk side (32)\n"
+                 "  --origin COL ROW  tile at world (0, 0) (5 1, as the game places text maps)\n"
+                 "  --rooms SIZE ROOM generate a SIZE x SIZE map of ROOM x ROOM rooms with doors\n";
+}
+
+int main(int argc, char** argv) {
+    int chunkSize = 32;
+    int originCol = 5, originRow = 1;
+    int roomsSize = 0, roomSize = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() { return ++i < argc ? argv[i] : "0"; };
+
+        if (arg == "--chunk") {
+            chunkSize = atoi(next());
+        } else if (arg == "--origin") {
+            originCol = atoi(next());
+            originRow = atoi(next());
+        } else if (arg == "--rooms") {
+            roomsSize = atoi(next());
+            roomSize = atoi(next());
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage();
+            return -1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    bool generate = roomsSize > 0;
+    if (chunkSize <= 0 || paths.size() != (generate ? 1u : 2u) || (generate && roomSize < 2)) {
+        printUsage();
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const std::string& output = paths.back();
+    bool written;
+    int columns, rows;
+
+    if (generate) {
+        columns = rows = roomsSize;
+        written = WriteTileMap(output, columns, rows, chunkSize, originCol, originRow, [&](int col, int row) {
+            bool wallRow = row % roomSize == 0 || row == rows - 1;
+            bool wallCol = col % roomSize == 0 || col == columns - 1;
+            bool door = (wallRow && col % roomSize == roomSize / 2) || (wallCol && row % roomSize == roomSize / 2);
+            return (wallRow || wallCol) && !door ? CollisionGrid::Tile::Wall : CollisionGrid::Tile::Floor;
+        });
+    } else {
+        std::vector<std::string> text;
+        if (!LoadTextMap(paths[0], text)) {
+            std::cerr << "Failed to open map file: " << paths[0] << "\n";
+            return -1;
+        }
+        columns = 0;
+        for (auto& line : text) columns = std::max(columns, static_cast<int>(line.size()));
+        rows = static_cast<int>(text.size());
+        written = WriteTileMap(output, columns, rows, chunkSize, originCol, originRow, [&](int col, int row) {
+            if (col >= static_cast<int>(text[row].size())) return CollisionGrid::Tile::Void;
+            return text[row][col] == '#' ? CollisionGrid::Tile::Wall : CollisionGrid::Tile::Floor;
+        });
+    }
+    if (!written) {
+        std::cerr << "Failed to write " << output << "\n";
+        return -1;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %dx%d tiles in %dx%d chunks of %d, %.1f ms\n", output.c_str(), columns, rows,
+           (columns + chunkSize - 1) / chunkSize, (rows + chunkSize - 1) / chunkSize, chunkSize, ms);
+    return 0;
+}
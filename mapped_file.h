@@ -0,0 +1,131 @@
+#pragma once
+
+// A whole file mapped into memory, for the packet logs and the binary tile maps
+
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // std::min and std::max in the headers that follow
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read or write view of a whole file
+class MappedFile {
+public:
+    ~MappedFile() { close(); }
+
+    // Creates or truncates the file and maps `capacity` bytes for writing
+    bool create(const std::string& path, size_t capacity) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+#endif
+        writable = true;
+        return resize(capacity);
+    }
+
+    bool openRead(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return false;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) return false;
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        view = mapped == MAP_FAILED ? nullptr : static_cast<uint8_t*>(mapped);
+        size = static_cast<size_t>(st.st_size);
+#endif
+        return view != nullptr;
+    }
+
+    // Remaps a writable file at a new size, the contents up to the smaller size are kept
+    bool resize(size_t newSize) {
+        unmap();
+#ifdef _WIN32
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(newSize);
+        if (!SetFilePointerEx(file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) return false;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (!mapping) return false;
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+#else
+        if (ftruncate(fd, static_cast<off_t>(newSize)) != 0) return false;
+        void* mapped = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        view = mapped == MAP_FAILED ? nullptr : static_cast<uint8_t*>(mapped);
+#endif
+        size = newSize;
+        return view != nullptr;
+    }
+
+    // finalSize: cut a writable file to this many bytes before closing
+    void close(size_t finalSize = 0) {
+        unmap();
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) {
+            if (writable && finalSize) {
+                LARGE_INTEGER end;
+                end.QuadPart = static_cast<LONGLONG>(finalSize);
+                SetFilePointerEx(file, end, nullptr, FILE_BEGIN);
+                SetEndOfFile(file);
+            }
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd >= 0) {
+            if (writable && finalSize) {
+                // a failed cut only leaves zeros at the end, which the reader stops at
+                int result = ftruncate(fd, static_cast<off_t>(finalSize));
+                (void)result;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        writable = false;
+    }
+
+    uint8_t* data() const { return view; }
+    size_t getSize() const { return size; }
+
+private:
+    void unmap() {
+#ifdef _WIN32
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (view) munmap(view, size);
+#endif
+        view = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    uint8_t* view = nullptr;
+    size_t size = 0;
+    bool writable = false;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free multi-producer single-consumer queue (Vyukov), Capacity must be a power of two
+template<typename T, size_t Capacity>
+class MPSCQueue {
+    public:
+        MPSCQueue() {
+            for (size_t i = 0; i < Capacity; ++i) m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Returns false if the queue is full
+        bool TryPush(const T& value) {
+            size_t pos = m_tail.load(std::memory_order_relaxed);
+            while (true) {
+                Cell& cell = m_cells[pos & (Capacity - 1)];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0) {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Only called from the consuming thread
+        bool TryPop(T& value) {
+            Cell& cell = m_cells[m_head & (Capacity - 1)];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0) return false;
+
+            value = cell.value;
+            cell.sequence.store(m_head + Capacity, std::memory_order_release);
+            m_head++;
+            return true;
+        }
+
+        // Only exact on the consuming thread, concurrent pushes may already be in flight
+        size_t Size() const {
+            return m_tail.load(std::memory_order_relaxed) - m_head;
+        }
+
+    private:
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        Cell m_cells[Capacity];
+        alignas(64) std::atomic<size_t> m_tail{0};
+        alignas(64) size_t m_head = 0;
+};
+
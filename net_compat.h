@@ -0,0 +1,44 @@
+#pragma once
+
+// Winsock on Windows, the same names mapped onto BSD sockets elsewhere, so the
+// receiver and the headless tools also build on Linux.
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#else
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+typedef unsigned long u_long;
+struct WSADATA {};
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define MAKEWORD(low, high) ((unsigned short)(((low) & 0xff) | (((high) & 0xff) << 8)))
+
+inline int WSAStartup(unsigned short, WSADATA*) { return 0; }
+inline int WSACleanup() { return 0; }
+inline int WSAGetLastError() { return errno; }
+inline int closesocket(SOCKET sock) { return close(sock); }
+
+inline int ioctlsocket(SOCKET sock, unsigned long command, u_long* argument) {
+    if (command == (unsigned long)FIONBIO) {
+        int flags = fcntl(sock, F_GETFL, 0);
+        return fcntl(sock, F_SETFL, *argument ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+    }
+    return ioctl(sock, command, argument);
+}
+
+#endif
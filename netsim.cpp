@@ -0,0 +1,515 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "net_compat.h"
+#include "stream_stats.h"
+#include "stream_transport.h"
+
+// UDP impairment proxy between the game and one receiver, for testing the transport on
+// loopback under loss, bursts, jitter, reordering, duplication and bandwidth caps.
+//
+//   receiver --reports/input--> netsim:8887 --> game:8888
+//   receiver <-----video------- netsim:9990 <-- game
+//
+// Start the receiver with the proxy as its game port: receiver.exe 9999 8887
+// The proxy rewrites the video port in the receiver reports, so the game sends the
+// receiver's layer to the proxy, which forwards it to the receiver's real port.
+// All randomness comes from one seeded generator, a run is repeatable for a given seed
+// as long as the packets arrive in the same order.
+
+constexpr char LOOPBACK[] = "::1";
+constexpr uint16_t DEFAULT_GAME_PORT = 8888;
+constexpr uint16_t DEFAULT_CONTROL_PORT = 8887;
+constexpr uint16_t DEFAULT_PROXY_VIDEO_PORT = 9990;
+constexpr uint8_t PACKET_RECEIVER_REPORT = 0x01;
+static constexpr int MAX_UDP_PACKET_SIZE = 65536;
+static constexpr double STALE_FRAME_SECONDS = 2.0; // forgotten after that
+static constexpr double IN_FLIGHT_SECONDS = 0.5;   // younger incomplete frames are not counted as lost yet
+
+// === Wire Formats (see game.cpp / receiver.cpp) ===
+#pragma pack(push, 1)
+struct ReceiverReport {
+    uint8_t  type;
+    uint16_t video_port;
+    double   timestamp;
+    uint32_t bytes_received;
+    uint32_t expected_packets;
+    uint32_t received_packets;
+    float    frame_rate;
+};
+#pragma pack(pop)
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// xorshift64*, unlike the std distributions it gives the same numbers on every platform
+class SimRandom {
+public:
+    explicit SimRandom(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); } // [0, 1)
+    bool chance(double p) { return p > 0.0 && uniform() < p; }
+
+    // Box-Muller
+    double normal() {
+        double u1 = std::max(uniform(), 1e-12);
+        double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+private:
+    uint64_t state;
+};
+
+enum class DelayDistribution { Uniform, Normal, Pareto };
+
+struct Impairment {
+    std::string name = "custom";
+    double loss = 0.0;              // independent loss per packet
+    double goodToBad = 0.0;         // Gilbert-Elliott, used instead of `loss` when > 0
+    double badToGood = 0.0;
+    double lossGood = 0.0;
+    double lossBad = 1.0;
+    double delayMs = 0.0;
+    double jitterMs = 0.0;
+    DelayDistribution distribution = DelayDistribution::Uniform;
+    double duplicate = 0.0;
+    double reorder = 0.0;           // chance of holding a packet back by reorderMs
+    double reorderMs = 20.0;
+    double rateKbps = 0.0;          // 0: unlimited
+    size_t queueBytes = 64 * 1024;  // tail drop beyond this backlog when rate limited
+};
+
+// One direction of the link. Packets are scheduled when submitted and come out of
+// release() once due; the rate limit serializes them like a bottleneck link with a
+// drop-tail queue, delay and jitter are added after that.
+class ImpairedLink {
+public:
+    ImpairedLink(const Impairment& config, SimRandom& random) : config(config), random(random) {}
+
+    void setConfig(const Impairment& impairment) {
+        config = impairment;
+        badState = false;
+    }
+
+    void submit(const char* data, int size, double now) {
+        submitted++;
+        if (lose()) {
+            dropped++;
+            return;
+        }
+
+        double departure = now;
+        if (config.rateKbps > 0.0) {
+            double bytesPerSecond = config.rateKbps * 1000.0 / 8.0;
+            double backlog = std::max(0.0, linkFree - now) * bytesPerSecond;
+            if (backlog + size > config.queueBytes) {
+                dropped++;
+                return;
+            }
+            linkFree = std::max(linkFree, now) + size / bytesPerSecond;
+            departure = linkFree;
+        }
+
+        schedule(data, size, departure + delay());
+        if (random.chance(config.duplicate)) {
+            duplicated++;
+            schedule(data, size, departure + delay());
+        }
+    }
+
+    template<typename Send>
+    void release(double now, Send send) {
+        while (!pending.empty() && pending.top().release <= now) {
+            const Pending& packet = pending.top();
+            send(packet.data.data(), static_cast<int>(packet.data.size()));
+            released++;
+            pending.pop();
+        }
+    }
+
+    void resetStats() { submitted = dropped = duplicated = released = 0; }
+
+    uint64_t submitted = 0;
+    uint64_t dropped = 0;
+    uint64_t duplicated = 0;
+    uint64_t released = 0;
+
+private:
+    struct Pending {
+        double release;
+        uint64_t order; // keeps packets with the same release time in submit order
+        std::vector<char> data;
+        bool operator>(const Pending& other) const {
+            return release != other.release ? release > other.release : order > other.order;
+        }
+    };
+
+    bool lose() {
+        if (config.goodToBad <= 0.0) return random.chance(config.loss);
+        badState = badState ? !random.chance(config.badToGood) : random.chance(config.goodToBad);
+        return random.chance(badState ? config.lossBad : config.lossGood);
+    }
+
+    double delay() {
+        double ms = config.delayMs;
+        if (config.jitterMs > 0.0) {
+            switch (config.distribution) {
+                case DelayDistribution::Uniform: ms += config.jitterMs * (2.0 * random.uniform() - 1.0); break;
+                case DelayDistribution::Normal:  ms += config.jitterMs * random.normal(); break;
+                case DelayDistribution::Pareto:  ms += config.jitterMs * (std::pow(1.0 - random.uniform(), -1.0 / 2.5) - 1.0); break;
+            }
+        }
+        if (random.chance(config.reorder)) ms += config.reorderMs;
+        return std::max(0.0, ms) / 1000.0;
+    }
+
+    void schedule(const char* data, int size, double releaseTime) {
+        pending.push(Pending{ releaseTime, nextOrder++, std::vector<char>(data, data + size) });
+    }
+
+    Impairment config;
+    SimRandom& random;
+    bool badState = false;
+    double linkFree = 0.0;
+    uint64_t nextOrder = 0;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+};
+
+// Follows the video fragments through the proxy: a frame is delivered once every
+// fragment came out, its latency is the time from its last fragment going in.
+class FrameTracker {
+public:
+    void onIn(const char* data, int size, double now) {
+        FragmentHeader_t header;
+        if (!parse(data, size, header)) return;
+
+        auto [it, inserted] = frames.try_emplace(header.frame_id);
+        if (inserted) {
+            it->second.seen.assign(header.total_fragments, false);
+            framesIn++;
+        }
+        it->second.lastIn = now;
+        bytesIn += size;
+    }
+
+    void onOut(const char* data, int size, double now) {
+        FragmentHeader_t header;
+        if (!parse(data, size, header)) return;
+        bytesOut += size;
+
+        auto it = frames.find(header.frame_id);
+        if (it == frames.end() || header.fragment_index >= it->second.seen.size()) return;
+        FrameProgress& frame = it->second;
+        if (frame.seen[header.fragment_index]) return; // duplicate
+        frame.seen[header.fragment_index] = true;
+
+        if (++frame.delivered == frame.seen.size()) {
+            framesDelivered++;
+            latencySamples.Add((now - frame.lastIn) * 1000.0);
+            frames.erase(it);
+        }
+    }
+
+    void prune(double now) {
+        for (auto it = frames.begin(); it != frames.end();) {
+            if (now - it->second.lastIn > STALE_FRAME_SECONDS) it = frames.erase(it);
+            else ++it;
+        }
+    }
+
+    // Frames that may still complete, left out of the delivery rate
+    size_t inFlight(double now) const {
+        size_t count = 0;
+        for (auto& [id, frame] : frames) {
+            if (now - frame.lastIn < IN_FLIGHT_SECONDS) count++;
+        }
+        return count;
+    }
+
+    void reset() { *this = FrameTracker(); }
+
+    uint64_t framesIn = 0;
+    uint64_t framesDelivered = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    stream_stats::RollingSamples<1024> latencySamples;
+
+private:
+    struct FrameProgress {
+        std::vector<bool> seen;
+        size_t delivered = 0;
+        double lastIn = 0.0;
+    };
+
+    static bool parse(const char* data, int size, FragmentHeader_t& header) {
+        const char* payload;
+        int payloadSize;
+        return ParseFragment(data, size, header, payload, payloadSize) && header.total_fragments > 0;
+    }
+
+    std::unordered_map<uint32_t, FrameProgress> frames;
+};
+
+// === Scenarios ===
+// Each one stresses a transport feature: fragment reassembly under loss, the simulcast
+// layer switch (reports above 5% loss), reordering in the reassembly map and the
+// resolution policy under a bandwidth cap.
+std::vector<Impairment> builtinScenarios() {
+    std::vector<Impairment> scenarios;
+    Impairment s;
+
+    s = Impairment(); s.name = "clean";
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "loss 1%"; s.loss = 0.01;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "loss 8%"; s.loss = 0.08;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "burst loss"; s.goodToBad = 0.01; s.badToGood = 0.25; s.lossBad = 0.8;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "jitter 40+-15ms"; s.delayMs = 40.0; s.jitterMs = 15.0; s.distribution = DelayDistribution::Normal;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "pareto tail"; s.delayMs = 20.0; s.jitterMs = 10.0; s.distribution = DelayDistribution::Pareto;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "reorder+dup"; s.reorder = 0.05; s.duplicate = 0.02;
+    scenarios.push_back(s);
+
+    s = Impairment(); s.name = "cap 250kbps"; s.rateKbps = 250.0; s.queueBytes = 32 * 1024;
+    scenarios.push_back(s);
+
+    return scenarios;
+}
+
+void printSummary(const std::string& name, const ImpairedLink& link, FrameTracker& tracker, double seconds, double now) {
+    uint64_t framesDone = tracker.framesIn - tracker.inFlight(now);
+    double delivery = framesDone ? 100.0 * tracker.framesDelivered / framesDone : 0.0;
+    double packetLoss = link.submitted ? 100.0 * link.dropped / link.submitted : 0.0;
+    printf("%-18s %8.1f%% %9.1f%% %9.1f %9.1f %9.1f %9.1f\n", name.c_str(), packetLoss, delivery,
+           tracker.bytesIn * 8.0 / seconds / 1000.0, tracker.bytesOut * 8.0 / seconds / 1000.0,
+           tracker.latencySamples.Percentile(0.5), tracker.latencySamples.Percentile(0.99));
+    fflush(stdout);
+}
+
+void printHeader() {
+    printf("%-18s %9s %10s %9s %9s %9s %9s\n", "scenario", "pkt loss", "frames ok", "kbps in", "kbps out", "p50 ms", "p99 ms");
+}
+
+// === Network Setup ===
+int startWinsock() {
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa);
+}
+
+SOCKET bindSocket(uint16_t port) {
+    SOCKET sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    u_long mode = 1;
+    ioctlsocket(sock, FIONBIO, &mode);
+
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(port);
+    addr.sin6_addr = in6addr_any;
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+void printUsage() {
+    std::cerr << "usage: netsim [options]\n"
+                 "  --game-port N        game control port (8888)\n"
+                 "  --control-port N     port the receiver sends reports and input to (8887)\n"
+                 "  --video-port N       port the game sends the video to (9990)\n"
+                 "  --seed N             random seed (1)\n"
+                 "  --loss P             independent loss probability\n"
+                 "  --burst P R          Gilbert-Elliott loss, P good->bad, R bad->good\n"
+                 "  --burst-loss G B     loss in the good and the bad state (0 1)\n"
+                 "  --delay MS           fixed delay\n"
+                 "  --jitter MS          delay variation\n"
+                 "  --distribution D     uniform, normal or pareto\n"
+                 "  --duplicate P        duplication probability\n"
+                 "  --reorder P          chance to hold a packet back by 20 ms\n"
+                 "  --rate KBPS          bandwidth cap with a 64 KiB drop-tail queue\n"
+                 "  --upstream           impair reports and input too\n"
+                 "  --scenarios SECONDS  run the built-in scenarios for SECONDS each and print a table\n";
+}
+
+int main(int argc, char** argv) {
+    uint16_t gamePort = DEFAULT_GAME_PORT;
+    uint16_t controlPort = DEFAULT_CONTROL_PORT;
+    uint16_t proxyVideoPort = DEFAULT_PROXY_VIDEO_PORT;
+    uint64_t seed = 1;
+    bool impairUpstream = false;
+    double scenarioSeconds = 0.0;
+    Impairment custom;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // consumes the next argument as a number
+        auto next = [&]() { return ++i < argc ? atof(argv[i]) : 0.0; };
+
+        if (arg == "--game-port") {
+            gamePort = static_cast<uint16_t>(next());
+        } else if (arg == "--control-port") {
+            controlPort = static_cast<uint16_t>(next());
+        } else if (arg == "--video-port") {
+            proxyVideoPort = static_cast<uint16_t>(next());
+        } else if (arg == "--seed") {
+            seed = static_cast<uint64_t>(next());
+        } else if (arg == "--loss") {
+            custom.loss = next();
+        } else if (arg == "--burst") {
+            custom.goodToBad = next();
+            custom.badToGood = next();
+        } else if (arg == "--burst-loss") {
+            custom.lossGood = next();
+            custom.lossBad = next();
+        } else if (arg == "--delay") {
+            custom.delayMs = next();
+        } else if (arg == "--jitter") {
+            custom.jitterMs = next();
+        } else if (arg == "--duplicate") {
+            custom.duplicate = next();
+        } else if (arg == "--reorder") {
+            custom.reorder = next();
+        } else if (arg == "--rate") {
+            custom.rateKbps = next();
+        } else if (arg == "--upstream") {
+            impairUpstream = true;
+        } else if (arg == "--scenarios") {
+            scenarioSeconds = next();
+        } else if (arg == "--distribution" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "normal") custom.distribution = DelayDistribution::Normal;
+            else if (name == "pareto") custom.distribution = DelayDistribution::Pareto;
+            else custom.distribution = DelayDistribution::Uniform;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if (startWinsock() != 0) return -1;
+
+    SOCKET controlSock = bindSocket(controlPort);
+    SOCKET videoSock = bindSocket(proxyVideoPort);
+    if (controlSock == INVALID_SOCKET || videoSock == INVALID_SOCKET) {
+        std::cerr << "Failed to bind the proxy ports\n";
+        return -1;
+    }
+
+    sockaddr_in6 gameAddr{};
+    gameAddr.sin6_family = AF_INET6;
+    gameAddr.sin6_port = htons(gamePort);
+    inet_pton(AF_INET6, LOOPBACK, &gameAddr.sin6_addr);
+
+    sockaddr_in6 receiverAddr{}; // learned from the first report
+    bool haveReceiver = false;
+
+    std::vector<Impairment> scenarios = scenarioSeconds > 0.0 ? builtinScenarios() : std::vector<Impairment>{ custom };
+    SimRandom random(seed);
+    Impairment clean;
+    ImpairedLink down(scenarios[0], random);
+    ImpairedLink up(impairUpstream ? scenarios[0] : clean, random);
+    FrameTracker tracker;
+
+    auto sendToGame = [&](const char* data, int size) {
+        sendto(controlSock, data, size, 0, (sockaddr*)&gameAddr, sizeof(gameAddr));
+    };
+    auto sendToReceiver = [&](const char* data, int size) {
+        tracker.onOut(data, size, nowSeconds());
+        sendto(videoSock, data, size, 0, (sockaddr*)&receiverAddr, sizeof(receiverAddr));
+    };
+
+    std::cout << "netsim: receiver -> :" << controlPort << " -> game :" << gamePort
+              << ", game -> :" << proxyVideoPort << " -> receiver, seed " << seed << "\n";
+    printHeader();
+
+    char buffer[MAX_UDP_PACKET_SIZE];
+    size_t scenario = 0;
+    double lastSummary = nowSeconds();
+    const double summaryInterval = scenarioSeconds > 0.0 ? scenarioSeconds : 5.0;
+
+    while (true) {
+        bool busy = false;
+        double now = nowSeconds();
+
+        // receiver -> game
+        sockaddr_in6 from;
+        socklen_t fromLen = sizeof(from);
+        int len = recvfrom(controlSock, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromLen);
+        if (len > 0) {
+            busy = true;
+            if (len == sizeof(ReceiverReport) && buffer[0] == PACKET_RECEIVER_REPORT) {
+                ReceiverReport report;
+                memcpy(&report, buffer, sizeof(report));
+                receiverAddr = from;
+                receiverAddr.sin6_port = htons(report.video_port);
+                haveReceiver = true;
+                report.video_port = proxyVideoPort; // the game sends the video to us
+                memcpy(buffer, &report, sizeof(report));
+            }
+            up.submit(buffer, len, now);
+        }
+
+        // game -> receiver
+        len = recvfrom(videoSock, buffer, sizeof(buffer), 0, nullptr, nullptr);
+        if (len > 0 && haveReceiver) {
+            busy = true;
+            tracker.onIn(buffer, len, now);
+            down.submit(buffer, len, now);
+        }
+
+        up.release(now, sendToGame);
+        down.release(now, sendToReceiver);
+
+        if (!haveReceiver) {
+            lastSummary = now; // measuring starts with the first report
+        } else if (now - lastSummary >= summaryInterval) {
+            tracker.prune(now);
+            printSummary(scenarios[scenario].name, down, tracker, now - lastSummary, now);
+            tracker.reset();
+            down.resetStats();
+            lastSummary = now;
+
+            if (scenarioSeconds > 0.0) {
+                if (++scenario == scenarios.size()) break;
+                down.setConfig(scenarios[scenario]);
+                if (impairUpstream) up.setConfig(scenarios[scenario]);
+            }
+        }
+
+        if (!busy) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    closesocket(controlSock);
+    closesocket(videoSock);
+    WSACleanup();
+    return 0;
+}
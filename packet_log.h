@@ -0,0 +1,112 @@
+#pragma once
+
+// Append-only capture of received datagrams with their arrival times, for replaying a
+// session through the receiver's reassembly and decode.
+//
+// The file is a PacketLogHeader followed by records: a PacketLogRecord and `size` bytes
+// of datagram. Writing goes through a memory mapping that grows in GROW_BYTES steps, so
+// appending is a memcpy on the receive path. The file is cut to the written size on
+// close; after a crash it ends in zeros, which the reader treats as the end.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "mapped_file.h"
+
+#pragma pack(push, 1)
+struct PacketLogHeader {
+    char     magic[8]; // "PKTLOG1"
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct PacketLogRecord {
+    double   arrival;  // steady clock, seconds
+    uint32_t size;
+};
+#pragma pack(pop)
+
+static constexpr char PACKET_LOG_MAGIC[8] = "PKTLOG1";
+static constexpr uint32_t PACKET_LOG_VERSION = 1;
+
+class PacketLogWriter {
+public:
+    static constexpr size_t GROW_BYTES = 16 << 20;
+
+    ~PacketLogWriter() { close(); }
+
+    bool open(const std::string& path) {
+        if (!file.create(path, GROW_BYTES)) return false;
+        PacketLogHeader header{};
+        memcpy(header.magic, PACKET_LOG_MAGIC, sizeof(header.magic));
+        header.version = PACKET_LOG_VERSION;
+        memcpy(file.data(), &header, sizeof(header));
+        used = sizeof(header);
+        return true;
+    }
+
+    bool append(const char* data, int size, double arrival) {
+        if (!file.data() || size <= 0) return false;
+        size_t needed = used + sizeof(PacketLogRecord) + size;
+        if (needed > file.getSize() && !file.resize(((needed + GROW_BYTES - 1) / GROW_BYTES) * GROW_BYTES)) return false;
+
+        PacketLogRecord record{ arrival, static_cast<uint32_t>(size) };
+        memcpy(file.data() + used, &record, sizeof(record));
+        memcpy(file.data() + used + sizeof(record), data, size);
+        used = needed;
+        records++;
+        return true;
+    }
+
+    void close() {
+        if (used) file.close(used);
+        used = 0;
+    }
+
+    uint64_t getRecords() const { return records; }
+
+private:
+    MappedFile file;
+    size_t used = 0;
+    uint64_t records = 0;
+};
+
+class PacketLogReader {
+public:
+    bool open(const std::string& path) {
+        if (!file.openRead(path) || file.getSize() < sizeof(PacketLogHeader)) return false;
+        PacketLogHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, PACKET_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != PACKET_LOG_VERSION) return false;
+        offset = sizeof(header);
+        return true;
+    }
+
+    // Returns false at the end of the log; `data` points into the mapping
+    bool next(const char*& data, int& size, double& arrival) {
+        if (offset + sizeof(PacketLogRecord) > file.getSize()) return false;
+        PacketLogRecord record;
+        memcpy(&record, file.data() + offset, sizeof(record));
+        if (record.size == 0 || offset + sizeof(record) + record.size > file.getSize()) return false;
+
+        data = reinterpret_cast<const char*>(file.data() + offset + sizeof(record));
+        size = static_cast<int>(record.size);
+        arrival = record.arrival;
+        offset += sizeof(record) + record.size;
+        return true;
+    }
+
+    // Arrival time of the next record without consuming it
+    bool peekArrival(double& arrival) const {
+        if (offset + sizeof(PacketLogRecord) > file.getSize()) return false;
+        PacketLogRecord record;
+        memcpy(&record, file.data() + offset, sizeof(record));
+        arrival = record.arrival;
+        return record.size != 0;
+    }
+
+private:
+    MappedFile file;
+    size_t offset = 0;
+};
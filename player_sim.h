@@ -0,0 +1,71 @@
+#pragma once
+
+// Player movement as a fixed-step simulation: the same keys from the same state give the
+// same result on every machine and at every frame rate. The game runs it in OnUpdate,
+// sim_bench.cpp runs many players without the engine.
+
+#include <cmath>
+#include <cstdint>
+
+#include "collision_grid.h"
+
+// bit index in InputPacket::key_state and in the keys of a tick
+enum InputKey : uint8_t { KEY_W, KEY_S, KEY_A, KEY_D, KEY_LEFT, KEY_RIGHT, KEY_SPACE, KEY_COUNT };
+
+static constexpr double SIM_TICK_SECONDS = 1.0 / 60.0;
+static constexpr int SIM_MAX_TICKS_PER_UPDATE = 5; // a longer stall is dropped, not caught up
+static constexpr float SIM_MOVE_SPEED = 5.0f;      // tiles per second
+static constexpr float SIM_TURN_SPEED = 1.5707964f; // radians per second
+static constexpr float SIM_PLAYER_RADIUS = 0.3f;
+static constexpr float SIM_MOUSE_TURN = 0.0034906585f; // radians per pixel of mouse_dx, 0.2 degrees
+
+// yaw turns the player around the world's up axis; 0 faces +y
+struct PlayerSimState {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    float yaw = 0.0f;
+    uint32_t tick = 0;
+    bool colliding = false; // touched something in the last tick
+};
+
+// The game's authoritative player after an update, sent to every receiver as a
+// MESSAGE_PLAYER_STATE. The receiver predicts from it: the game has run
+// ticks_since_input ticks since it applied input_sequence, later local ticks are replayed.
+#pragma pack(push, 1)
+struct PlayerStatePacket {
+    uint32_t tick;
+    uint32_t input_sequence;    // last InputPacket applied, 0 before the first
+    uint32_t ticks_since_input;
+    float    x, y, z;
+    float    yaw;
+};
+#pragma pack(pop)
+
+// Mouse turns are applied when their input is, not spread over ticks
+inline void TurnPlayer(PlayerSimState& state, int mouseDx) {
+    state.yaw -= SIM_MOUSE_TURN * static_cast<float>(mouseDx);
+}
+
+// One tick of held keys. Directions are taken before turning, as the input callbacks did.
+// Returns true if the player ran into something it did not touch in the tick before.
+inline bool StepPlayer(PlayerSimState& state, uint16_t keys, float dt, const CollisionGrid& grid) {
+    float forwardX = -std::sin(state.yaw), forwardY = std::cos(state.yaw);
+    float rightX = -std::cos(state.yaw), rightY = -std::sin(state.yaw);
+
+    float moveX = 0.0f, moveY = 0.0f;
+    if (keys & (1u << KEY_W)) { moveX += forwardX; moveY += forwardY; }
+    if (keys & (1u << KEY_S)) { moveX -= forwardX; moveY -= forwardY; }
+    if (keys & (1u << KEY_A)) { moveX += rightX; moveY += rightY; }
+    if (keys & (1u << KEY_D)) { moveX -= rightX; moveY -= rightY; }
+    if (keys & (1u << KEY_LEFT)) state.yaw += SIM_TURN_SPEED * dt;
+    if (keys & (1u << KEY_RIGHT)) state.yaw -= SIM_TURN_SPEED * dt;
+
+    state.tick++;
+    bool wasColliding = state.colliding;
+    state.colliding = false;
+    float length = std::sqrt(moveX * moveX + moveY * moveY);
+    if (length > 0.0f) {
+        float scale = SIM_MOVE_SPEED * dt / length;
+        state.colliding = grid.MoveCircle(state.x, state.y, moveX * scale, moveY * scale, SIM_PLAYER_RADIUS);
+    }
+    return state.colliding && !wasColliding;
+}
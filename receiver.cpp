@@ -11,13 +11,21 @@
 #include <cstring>
 #include <chrono>
 #include <atomic>
-#include <winsock2.h>
-#include <ws2tcpip.h>
 #include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <cmath>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
+#include "stream_trace.h"
+#include "stream_log.h"
+#include "stream_stats.h"
+#include "net_compat.h"
+#include "packet_log.h"
+#include "stream_transport.h"
+#include "tile_map.h"
+#include "player_sim.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -32,18 +40,60 @@ extern "C" {
 #include <SDL3/SDL.h>
 
 constexpr char GAME_HOST[] = "::1"; // IPv6 loopback address
-constexpr uint16_t GAME_PORT = 8888;
+constexpr uint16_t DEFAULT_GAME_PORT = 8888;
+constexpr uint16_t DEFAULT_VIDEO_PORT = 9999;
+constexpr uint8_t PACKET_RECEIVER_REPORT = 0x01;
+constexpr uint8_t PACKET_INPUT = 0x02;
+
+constexpr uint8_t INPUT_MOUSE = 0x01;
+constexpr int INPUT_EVENT_HISTORY = 8;
+
+// Sent on every key change and repeated while keys are held, so a lost packet is
+// healed by the next one. The last key edges travel along in every packet.
+#pragma pack(push, 1)
+struct InputPacket {
+    uint8_t  type;           // PACKET_INPUT
+    uint8_t  flags;          // INPUT_MOUSE
+    uint16_t key_state;      // held keys, bit per InputKey
+    uint32_t sequence;
+    double   timestamp;      // receiver clock, seconds
+    int16_t  mouse_dx;
+    int16_t  mouse_dy;
+    uint32_t event_sequence; // sequence of events[0]; events[i] has event_sequence - i
+    uint8_t  events[INPUT_EVENT_HISTORY]; // InputKey | 0x80 when pressed, newest first
+};
+#pragma pack(pop)
+
+// Prefixed to every encoded frame for input-to-photon tracing. Times are the game's
+// steady clock in seconds; input_timestamp is our own clock echoed back.
+#pragma pack(push, 1)
+struct FrameMeta {
+    int64_t  pts;            // -1 marks the shutdown message
+    uint32_t input_sequence; // 0 if no new input was applied before this capture
+    double   input_timestamp;
+    double   input_arrival;
+    double   capture_start;
+    double   capture_end;
+    double   encode_end;
+};
+#pragma pack(pop)
+
+// steady_clock in seconds, the clock the game stamps its fragments with. Stages that
+// cross machines are only meaningful when both run on the same host.
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 SOCKET controlSocket;
 sockaddr_in6 gameAddr;
 
-bool initControlSocket() {
+bool initControlSocket(uint16_t gamePort) {
     controlSocket = socket(AF_INET6, SOCK_DGRAM, 0); // IPv6
     if (controlSocket == INVALID_SOCKET) return false;
 
     memset(&gameAddr, 0, sizeof(gameAddr));
     gameAddr.sin6_family = AF_INET6;
-    gameAddr.sin6_port = htons(GAME_PORT);
+    gameAddr.sin6_port = htons(gamePort);
 
     if (inet_pton(AF_INET6, GAME_HOST, &gameAddr.sin6_addr) != 1) {
         std::cerr << "Invalid IPv6 address\n";
@@ -53,40 +103,244 @@ bool initControlSocket() {
     return true;
 }
 
-void sendKeyToGame(uint8_t scancode, float dt) {
-    std::cout << "[KeyPress] scancode: " << static_cast<int>(scancode) << std::endl;
-    char buffer[16];
-    sprintf(buffer, "%u:%.3f", scancode, dt);
-    int ret = sendto(controlSocket, buffer, strlen(buffer), 0, (sockaddr*)&gameAddr, sizeof(gameAddr));
+// === Input State ===
+static constexpr uint64_t INPUT_HEARTBEAT_MS = 100;   // resend the key state while keys are held
+static constexpr int INPUT_TRAILING_PACKETS = 3;      // extra sends after the last release
+
+uint32_t inputSequence = 0;
+uint16_t keyState = 0;
+uint32_t keyEventSequence = 0;
+uint8_t keyEvents[INPUT_EVENT_HISTORY] = {};
+uint64_t lastInputSendMs = 0;
+int trailingPackets = 0;
+
+int keyFromScancode(SDL_Scancode scancode) {
+    switch (scancode) {
+        case SDL_SCANCODE_W: return KEY_W;
+        case SDL_SCANCODE_S: return KEY_S;
+        case SDL_SCANCODE_A: return KEY_A;
+        case SDL_SCANCODE_D: return KEY_D;
+        case SDL_SCANCODE_LEFT: return KEY_LEFT;
+        case SDL_SCANCODE_RIGHT: return KEY_RIGHT;
+        case SDL_SCANCODE_SPACE: return KEY_SPACE;
+        default: return -1;
+    }
+}
+
+void sendInputToGame(int16_t mouseDx = 0, int16_t mouseDy = 0) {
+    InputPacket packet;
+    packet.type = PACKET_INPUT;
+    packet.flags = (mouseDx || mouseDy) ? INPUT_MOUSE : 0;
+    packet.key_state = keyState;
+    packet.sequence = ++inputSequence;
+    packet.timestamp = nowSeconds();
+    packet.mouse_dx = mouseDx;
+    packet.mouse_dy = mouseDy;
+    packet.event_sequence = keyEventSequence;
+    memcpy(packet.events, keyEvents, sizeof(keyEvents));
+    int ret = sendto(controlSocket, reinterpret_cast<char*>(&packet), sizeof(packet), 0, (sockaddr*)&gameAddr, sizeof(gameAddr));
+    lastInputSendMs = SDL_GetTicks();
 
     if (ret < 0) {
-        std::cerr << "Failed to send information :< " << "\n";
+        LOG_ERROR("Failed to send input to the game: %d", WSAGetLastError());
     }
 }
 
-// === Structures and Types ===
-typedef struct RTHeader {
-    double time;
-    unsigned long packetnum;
-} RTHeader_t;
+// === Prediction ===
+// With --predict MAP the receiver runs the game's player simulation on its own keys and
+// draws the predicted player over the video, so a key press shows within a tick instead
+// of a round trip. Every state packet of the game resets the prediction to the
+// authoritative state and replays the local ticks the game has not simulated yet. Only
+// the walls are known here, cyphers are left to the game's corrections.
+static constexpr size_t PREDICTION_HISTORY_TICKS = 120; // longer round trips are only approximated
+
+struct PredictedTick {
+    uint16_t keys;
+    int mouseDx;            // turned before this tick
+    uint32_t inputSequence; // newest InputPacket sent before this tick
+};
 
-#pragma pack(push, 1)
-typedef struct FragmentHeader {
-    uint32_t frame_id;
-    uint16_t total_fragments;
-    uint16_t fragment_index;
-} FragmentHeader_t;
-#pragma pack(pop)
+struct Prediction {
+    bool enabled = false;
+    CollisionGrid grid;
+    PlayerSimState state;              // predicted, drawn
+    PlayerSimState authoritative;      // last state from the game
+    std::deque<PredictedTick> history; // oldest first
+    double accumulator = 0.0;
+    double lastUpdate = 0.0;
+    uint16_t taps = 0;   // pressed since the last tick, the game moves them once as well
+    int mouseDx = 0;     // sent since the last tick
+    stream_stats::RollingSamples<128> correction; // tiles the prediction moved on each state packet
+};
+Prediction prediction;
+
+// the newest state packet, from the decode thread to the main thread
+std::mutex playerStateMutex;
+PlayerStatePacket latestPlayerState{};
+bool playerStateFresh = false;
+
+void reconcilePrediction(Prediction& p, const PlayerStatePacket& packet) {
+    p.authoritative.x = packet.x;
+    p.authoritative.y = packet.y;
+    p.authoritative.z = packet.z;
+    p.authoritative.yaw = packet.yaw;
+    p.authoritative.tick = packet.tick;
+
+    // the game has run ticks_since_input ticks from the first local tick that had
+    // input_sequence, the later ones are still ahead of it; so are the mouse turns
+    // of inputs it has not applied
+    size_t first = 0;
+    while (first < p.history.size() && p.history[first].inputSequence < packet.input_sequence) first++;
+
+    PlayerSimState state = p.authoritative;
+    state.colliding = p.state.colliding;
+    for (size_t i = first; i < p.history.size(); ++i) {
+        const PredictedTick& tick = p.history[i];
+        if (tick.inputSequence > packet.input_sequence) TurnPlayer(state, tick.mouseDx);
+        if (i >= first + packet.ticks_since_input) StepPlayer(state, tick.keys, static_cast<float>(SIM_TICK_SECONDS), p.grid);
+    }
+
+    p.correction.Add(std::sqrt((state.x - p.state.x) * (state.x - p.state.x) + (state.y - p.state.y) * (state.y - p.state.y)));
+    p.state = state;
+}
+
+// Main thread, every loop: reconciles with a new state packet, then runs the local
+// ticks that are due with the keys held right now
+void updatePrediction(Prediction& p, double now) {
+    PlayerStatePacket packet;
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> lock(playerStateMutex);
+        if (playerStateFresh) {
+            packet = latestPlayerState;
+            playerStateFresh = false;
+            fresh = true;
+        }
+    }
+    if (fresh) reconcilePrediction(p, packet);
+
+    if (p.lastUpdate == 0.0) p.lastUpdate = now;
+    p.accumulator += now - p.lastUpdate;
+    p.lastUpdate = now;
+
+    int ticks = 0;
+    while (p.accumulator >= SIM_TICK_SECONDS && ticks < SIM_MAX_TICKS_PER_UPDATE) {
+        PredictedTick tick{ static_cast<uint16_t>(keyState | p.taps), p.mouseDx, inputSequence };
+        p.taps = 0;
+        p.mouseDx = 0;
+        TurnPlayer(p.state, tick.mouseDx);
+        StepPlayer(p.state, tick.keys, static_cast<float>(SIM_TICK_SECONDS), p.grid);
+
+        p.history.push_back(tick);
+        if (p.history.size() > PREDICTION_HISTORY_TICKS) p.history.pop_front();
+        p.accumulator -= SIM_TICK_SECONDS;
+        ticks++;
+    }
+    if (p.accumulator >= SIM_TICK_SECONDS) p.accumulator = std::fmod(p.accumulator, SIM_TICK_SECONDS);
+}
+
+// Key repeats are ignored, the game integrates held keys with its own frame time
+void onKeyEdge(SDL_Scancode scancode, bool down) {
+    int key = keyFromScancode(scancode);
+    if (key < 0) return;
+
+    LOG_DEBUG_LIMITED("[KeyPress] scancode %d %s", static_cast<int>(scancode), down ? "down" : "up");
+    if (down) keyState |= (1u << key);
+    else keyState &= ~(1u << key);
+    if (down) prediction.taps |= (1u << key);
+
+    memmove(keyEvents + 1, keyEvents, INPUT_EVENT_HISTORY - 1);
+    keyEvents[0] = static_cast<uint8_t>(key) | (down ? 0x80 : 0x00);
+    keyEventSequence++;
+
+    trailingPackets = INPUT_TRAILING_PACKETS;
+    sendInputToGame();
+}
+
+// === Structures and Types ===
+struct LatencySample {
+    FrameMeta meta;
+    double first_arrival;
+    double last_arrival;
+    double decoded = 0.0;
+};
 
 struct DecodedFrame {
     int width;
     int height;
     std::vector<uint8_t> rgba;
+    bool traced = false;    // carries an input, latency is measured when presented
+    LatencySample latency;
 };
 
+// 1 ms buckets up to one second
+class LatencyHistogram {
+public:
+    void add(double ms) {
+        int bucket = std::clamp(static_cast<int>(ms), 0, BUCKETS - 1);
+        buckets[bucket]++;
+        count++;
+        sum += ms;
+    }
+
+    double percentile(double p) const {
+        uint32_t target = static_cast<uint32_t>(p * count);
+        uint32_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen > target) return i;
+        }
+        return BUCKETS;
+    }
+
+    double mean() const { return count ? sum / count : 0.0; }
+    uint32_t samples() const { return count; }
+
+private:
+    static constexpr int BUCKETS = 1000;
+    uint32_t buckets[BUCKETS] = {};
+    uint32_t count = 0;
+    double sum = 0.0;
+};
+
+enum LatencyStage { INPUT_TRANSIT, GAME_TICK, CAPTURE, ENCODE, SEND, REASSEMBLY, DECODE, PRESENT, END_TO_END, STAGE_COUNT };
+const char* stageNames[STAGE_COUNT] = { "input transit", "game tick", "capture", "encode", "send", "reassembly", "decode", "present", "end-to-end" };
+LatencyHistogram latencyHistograms[STAGE_COUNT];
+
+// Straight to stdout like the other results: it must not be rate limited or end up out of
+// order with the metrics printed around it. Runs on the main thread every 50 traced inputs.
+void printLatencySummary() {
+    printf("[Latency] %d inputs traced\n", (int)latencyHistograms[END_TO_END].samples());
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        printf("  %14s: mean %.1f ms, p50 %.1f ms, p99 %.1f ms\n", stageNames[i], latencyHistograms[i].mean(),
+               latencyHistograms[i].percentile(0.5), latencyHistograms[i].percentile(0.99));
+    }
+    fflush(stdout);
+}
+
+void recordLatency(const LatencySample& sample, double presented) {
+    const FrameMeta& m = sample.meta;
+    double stages[STAGE_COUNT] = {
+        m.input_arrival - m.input_timestamp,
+        m.capture_start - m.input_arrival,
+        m.capture_end - m.capture_start,
+        m.encode_end - m.capture_end,
+        sample.first_arrival - m.encode_end,
+        sample.last_arrival - sample.first_arrival,
+        sample.decoded - sample.last_arrival,
+        presented - sample.decoded,
+        presented - m.input_timestamp
+    };
+    for (int i = 0; i < STAGE_COUNT; ++i) latencyHistograms[i].add(stages[i] * 1000.0);
+
+    if (latencyHistograms[END_TO_END].samples() % 50 == 0) printLatencySummary();
+}
+
 #pragma pack(push, 1)
 struct ReceiverReport {
-    double timestamp;
+    uint8_t  type;
+    uint16_t video_port; // the game sends our simulcast layer there
+    double   timestamp;
     uint32_t bytes_received;
     uint32_t expected_packets;
     uint32_t received_packets;
@@ -104,6 +358,9 @@ struct NAKPacket {
 // === Globals ===
 static constexpr int MAX_UDP_PACKET_SIZE = 65536;
 static constexpr int BUFFER_THRESHOLD = 5;
+// a replay decodes faster than it is presented (--max-speed), so it waits for the
+// main thread once this many pictures are queued instead of growing the queue
+static constexpr size_t REPLAY_QUEUE_DEPTH = 8;
 bool isSDLInitialized = false;
 
 std::mutex frameQueueMutex;
@@ -115,11 +372,20 @@ std::atomic<uint32_t> expected_packet_count{0};
 std::atomic<uint32_t> received_packet_count{0};
 std::atomic<uint32_t> decoded_frame_count{0};
 
-struct FrameBuffer {
-    uint16_t total_fragments = 0;
-    std::map<uint16_t, std::vector<uint8_t>> fragments;
-    size_t total_size = 0;
+// === Stream Health ===
+// filled by the decode thread, drawn as overlay and written to the metrics file by the main thread
+struct ReceiverHealth {
+    std::mutex mutex;
+    stream_stats::RollingRate frames;          // reassembled
+    stream_stats::RollingRate evictedFrames;   // given up incomplete by the reassembler
+    stream_stats::RollingRate bytes;
+    stream_stats::RollingRate expectedPackets;
+    stream_stats::RollingRate receivedPackets;
+    stream_stats::RollingSamples<128> decodeMs;
 };
+ReceiverHealth health;
+std::atomic<size_t> pendingFrameCount{0};      // frames waiting for fragments
+static constexpr double METRICS_INTERVAL = 1.0; // seconds
 
 // === Network Setup ===
 int startWinsock() {
@@ -130,78 +396,196 @@ int startWinsock() {
 void send_nak(SOCKET sock, const sockaddr_in6& sender_addr, uint32_t frame_id, uint16_t missing_index) {
     NAKPacket nak{frame_id, missing_index};
     sendto(sock, (char*)&nak, sizeof(nak), 0, (sockaddr*)&sender_addr, sizeof(sender_addr));
-    std::cout << "[NAK] Requested resend for frame " << frame_id << ", fragment " << missing_index << "\n";
+    LOG_DEBUG_LIMITED("[NAK] Requested resend for frame %u, fragment %u", frame_id, (unsigned)missing_index);
 }
 
-int receive_fragment(SOCKET sock, uint32_t& out_frame_id, uint16_t& out_total, uint16_t& out_index, std::vector<uint8_t>& out_payload) {
-    sockaddr_in6 si_other;
-    socklen_t slen = sizeof(si_other);
-    char recbuffer[MAX_UDP_PACKET_SIZE];
+// === Datagram Source ===
+// The video socket, optionally recording every datagram, or a packet log replayed
+// instead of the socket
+struct DatagramSource {
+    SOCKET sock = INVALID_SOCKET;
+    PacketLogWriter* recorder = nullptr;
+    PacketLogReader* replay = nullptr;
+    bool replayMaxSpeed = false;  // otherwise at the recorded pace
+    double replayOffset = 0.0;    // nowSeconds() minus log time, set by the first datagram
+};
 
-    int ret = recvfrom(sock, recbuffer, sizeof(recbuffer), 0, (sockaddr*)&si_other, &slen);
-    if (ret == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err == WSAEWOULDBLOCK) return 0;
-        std::cerr << "recvfrom failed: " << err << "\n";
-        return -1;
+std::atomic<bool> replayDone{false};
+uint64_t replayChecksum = 14695981039346656037ull; // over every decoded picture, see hashPicture
+
+// FNV-1a over 8 byte words, identical decodes of a log give identical checksums
+uint64_t hashPicture(uint64_t hash, const std::vector<uint8_t>& rgba) {
+    size_t words = rgba.size() / 8;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        memcpy(&word, rgba.data() + i * 8, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (size_t i = words * 8; i < rgba.size(); ++i) hash = (hash ^ rgba[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Returns 0 while the next datagram is not due yet, -1 at the end of the log
+int next_replayed_datagram(DatagramSource& source, const char*& datagram) {
+    double arrival;
+    if (!source.replay->peekArrival(arrival)) return -1;
+    if (!source.replayMaxSpeed) {
+        if (source.replayOffset == 0.0) source.replayOffset = nowSeconds() - arrival;
+        if (arrival + source.replayOffset > nowSeconds()) return 0;
     }
 
-    RTHeader_t* rt_header = (RTHeader_t*)recbuffer;
-    FragmentHeader_t* frag_header = (FragmentHeader_t*)(recbuffer + sizeof(RTHeader_t));
-    char* payload = recbuffer + sizeof(RTHeader_t) + sizeof(FragmentHeader_t);
-    int payloadSize = ret - (sizeof(RTHeader_t) + sizeof(FragmentHeader_t));
+    int size = 0;
+    source.replay->next(datagram, size, arrival);
+    return size;
+}
+
+// Messages arrive between the fragments on the video socket
+void receive_message(const FragmentHeader_t& header, const char* payload, int size) {
+    if (header.fragment_index != MESSAGE_PLAYER_STATE || size < (int)sizeof(PlayerStatePacket)) return;
+
+    PlayerStatePacket state;
+    memcpy(&state, payload, sizeof(state));
+    std::lock_guard<std::mutex> lock(playerStateMutex);
+    // reordered, unless the game restarted and counts from 0 again
+    if (state.tick <= latestPlayerState.tick && latestPlayerState.tick - state.tick < 1000) return;
+    latestPlayerState = state;
+    playerStateFresh = true;
+}
+
+int receive_fragment(DatagramSource& source, FragmentHeader_t& out_header, std::vector<char>& out_payload) {
+    char recbuffer[MAX_UDP_PACKET_SIZE];
+
+    for (;;) {
+        const char* datagram = recbuffer;
+        int ret;
+
+        if (source.replay) {
+            ret = next_replayed_datagram(source, datagram);
+            if (ret <= 0) return ret;
+        } else {
+            sockaddr_in6 si_other;
+            socklen_t slen = sizeof(si_other);
+            ret = recvfrom(source.sock, recbuffer, sizeof(recbuffer), 0, (sockaddr*)&si_other, &slen);
+            if (ret == SOCKET_ERROR) {
+                int err = WSAGetLastError();
+                if (err == WSAEWOULDBLOCK) return 0;
+                LOG_ERROR("recvfrom failed: %d", err);
+                return -1;
+            }
+            if (source.recorder && !source.recorder->append(recbuffer, ret, nowSeconds())) {
+                LOG_ERROR("Failed to record datagram");
+            }
+        }
+        TRACE_SCOPE("receive_fragment"); // empty polls are not traced
+        const char* payload;
+        int payloadSize;
+        if (!ParseFragment(datagram, ret, out_header, payload, payloadSize)) return 0;
+        if (IsMessage(out_header)) {
+            // recorded states belong to another session, the local prediction must not follow them
+            if (!source.replay) receive_message(out_header, payload, payloadSize);
+            continue; // not part of the video, read on
+        }
+        out_payload.assign(payload, payload + payloadSize);
+
+        total_bytes += payloadSize;
+        received_packet_count++;
+        {
+            double now = nowSeconds();
+            std::lock_guard<std::mutex> lock(health.mutex);
+            health.bytes.Add(payloadSize, now);
+            health.receivedPackets.Add(1.0, now);
+        }
 
-    out_frame_id = frag_header->frame_id;
-    out_total = frag_header->total_fragments;
-    out_index = frag_header->fragment_index;
-    out_payload.assign(payload, payload + payloadSize);
+        return payloadSize;
+    }
+}
 
-    total_bytes += payloadSize;
-    expected_packet_count += out_total;
-    received_packet_count++;
+// Fragments the report expects. The game numbers the frames it sends us consecutively, so
+// a jump in frame ids means whole frames were lost; nothing of them arrived to say how
+// many fragments they had, so they count with the recent average. A frame older than the
+// newest one was already counted in such a gap (or is a duplicate of a completed frame).
+struct ExpectedFragments {
+    bool started = false;
+    uint32_t newestFrameId = 0;
+    double averageFragments = 0.0;
+};
 
-    return payloadSize;
+uint32_t countExpectedFragments(ExpectedFragments& e, const FragmentHeader_t& header) {
+    int32_t distance = static_cast<int32_t>(header.frame_id - e.newestFrameId);
+    uint32_t expected = 0;
+    if (!e.started || distance > 1000 || distance < -1000) { // first frame, or the game restarted
+        expected = header.total_fragments;
+        e.newestFrameId = header.frame_id;
+        e.averageFragments = header.total_fragments;
+        e.started = true;
+    } else if (distance > 0) {
+        expected = header.total_fragments + static_cast<uint32_t>((distance - 1) * e.averageFragments + 0.5);
+        e.newestFrameId = header.frame_id;
+    }
+    e.averageFragments += (header.total_fragments - e.averageFragments) * 0.1;
+    return expected;
 }
 
-void decode_thread_func(SOCKET sock, AVCodecContext* codecCtx) {
-    std::unordered_map<uint32_t, FrameBuffer> frame_buffer_map;
+void decode_thread_func(DatagramSource source, AVCodecContext* codecCtx) {
+    TRACE_THREAD_NAME("decode");
+    FrameReassembler reassembler;
     AVPacket* packet = av_packet_alloc();
     AVFrame* frame = av_frame_alloc();
+    std::map<int64_t, LatencySample> traced_frames; // by pts, until the decoder outputs them
+    FragmentHeader_t header;
+    std::vector<char> payload;        // reused for every datagram
+    std::vector<uint8_t> full_frame;  // reused for every reassembled frame
+    ExpectedFragments expected_fragments;
 
     while (running.load()) {
-        uint32_t frame_id;
-        uint16_t total_fragments, fragment_index;
-        std::vector<uint8_t> payload;
-
-        int recv_ret = receive_fragment(sock, frame_id, total_fragments, fragment_index, payload);
+        int recv_ret = receive_fragment(source, header, payload);
+        if (recv_ret < 0 && source.replay) {
+            replayDone = true;
+            break;
+        }
         if (recv_ret <= 0) {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
+        double arrival = nowSeconds();
+
+        LatencySample sample{};
+        uint64_t evictedBefore = reassembler.GetEvictedFrames();
+        auto result = reassembler.AddFragment(header, payload.data(), (int)payload.size(), arrival, full_frame, sample.first_arrival);
+        if (reassembler.GetEvictedFrames() != evictedBefore) {
+            std::lock_guard<std::mutex> lock(health.mutex);
+            health.evictedFrames.Add(double(reassembler.GetEvictedFrames() - evictedBefore), arrival);
+        }
+        if (result == FrameReassembler::Result::Late) continue; // duplicate, or its frame was given up
+        if (result == FrameReassembler::Result::Rejected) {
+            LOG_WARN_LIMITED("Dropped fragment %u/%u of frame %u", (unsigned)header.fragment_index, (unsigned)header.total_fragments, header.frame_id);
+            continue;
+        }
+        if (result == FrameReassembler::Result::NewFrame || (result == FrameReassembler::Result::Complete && header.total_fragments == 1)) {
+            uint32_t expected = countExpectedFragments(expected_fragments, header); // once per frame
+            expected_packet_count += expected;
+            std::lock_guard<std::mutex> lock(health.mutex);
+            health.expectedPackets.Add(expected, arrival);
+        }
+        pendingFrameCount = reassembler.GetPendingFrames();
 
-        auto& buffer = frame_buffer_map[frame_id];
-        buffer.total_fragments = total_fragments;
-        buffer.fragments[fragment_index] = payload;
-        buffer.total_size += payload.size();
-
-        if (buffer.fragments.size() == total_fragments) {
-            std::vector<uint8_t> full_frame;
-            full_frame.reserve(buffer.total_size);
-            for (int i = 0; i < total_fragments; ++i) {
-                if (buffer.fragments.count(i) == 0) {
-                    std::cerr << "Missing fragment index " << i << " for frame " << frame_id << "\n";
-                    frame_buffer_map.erase(frame_id);
-                    break;
-                }
-                auto& frag = buffer.fragments[i];
-                full_frame.insert(full_frame.end(), frag.begin(), frag.end());
-            }
-            frame_buffer_map.erase(frame_id);
+        if (result == FrameReassembler::Result::Complete) {
+            sample.last_arrival = arrival;
             decoded_frame_count++;
 
+            if (full_frame.size() < sizeof(FrameMeta)) continue;
+            memcpy(&sample.meta, full_frame.data(), sizeof(FrameMeta));
+            if (sample.meta.pts < 0) continue; // shutdown message, nothing to decode
+            // replayed timestamps come from another session
+            if (sample.meta.input_sequence != 0 && !source.replay) traced_frames[sample.meta.pts] = sample;
+
+            size_t bitstream_size = full_frame.size() - sizeof(FrameMeta);
             av_packet_unref(packet);
-            av_new_packet(packet, full_frame.size());
-            memcpy(packet->data, full_frame.data(), full_frame.size());
+            av_new_packet(packet, bitstream_size);
+            memcpy(packet->data, full_frame.data() + sizeof(FrameMeta), bitstream_size);
+            packet->pts = sample.meta.pts; // follows the picture through B-frame reordering
+            TRACE_SCOPE("decode");
+            double decodeStart = nowSeconds();
             if (avcodec_send_packet(codecCtx, packet) == 0) {
                 while (avcodec_receive_frame(codecCtx, frame) == 0) {
                     int w = frame->width, h = frame->height;
@@ -209,14 +593,41 @@ void decode_thread_func(SOCKET sock, AVCodecContext* codecCtx) {
                     std::vector<uint8_t> rgba(w * h * 4);
                     uint8_t* dst[1] = { rgba.data() };
                     int linesize[1] = { w * 4 };
-                    sws_scale(sws, frame->data, frame->linesize, 0, h, dst, linesize);
+                    {
+                        TRACE_SCOPE("sws_scale");
+                        sws_scale(sws, frame->data, frame->linesize, 0, h, dst, linesize);
+                    }
                     sws_freeContext(sws);
 
+                    if (source.replay) replayChecksum = hashPicture(replayChecksum, rgba);
+
+                    DecodedFrame decoded{w, h, std::move(rgba)};
+                    auto traced = traced_frames.find(frame->pts);
+                    if (traced != traced_frames.end()) {
+                        decoded.traced = true;
+                        decoded.latency = traced->second;
+                        decoded.latency.decoded = nowSeconds();
+                    }
+                    // anything older than this picture will never come out of the decoder
+                    traced_frames.erase(traced_frames.begin(), traced_frames.upper_bound(frame->pts));
+
                     std::unique_lock<std::mutex> lock(frameQueueMutex);
-                    frameQueue.push({w, h, std::move(rgba)});
-                    frameQueueCondVar.notify_one();
+                    if (source.replay) {
+                        // running is cleared without the lock, so the wait wakes up to look at it
+                        while (frameQueue.size() >= REPLAY_QUEUE_DEPTH && running.load()) {
+                            frameQueueCondVar.wait_for(lock, std::chrono::milliseconds(50));
+                        }
+                    }
+                    frameQueue.push(std::move(decoded));
+                    frameQueueCondVar.notify_all(); // the main thread waits on the same condition variable
+
                 }
             }
+
+            double decodeEnd = nowSeconds();
+            std::lock_guard<std::mutex> lock(health.mutex);
+            health.frames.Add(1.0, decodeEnd);
+            health.decodeMs.Add((decodeEnd - decodeStart) * 1000.0);
         }
     }
 
@@ -224,101 +635,350 @@ void decode_thread_func(SOCKET sock, AVCodecContext* codecCtx) {
     av_packet_free(&packet);
 }
 
-void reportLoop(SOCKET reportSock, sockaddr_in6 senderAddr) {
-    const int interval_seconds = 10;
-    while (running.load()) {
-        std::this_thread::sleep_for(std::chrono::seconds(interval_seconds));
+// Rolling health as "name value" lines, shared by the overlay and the metrics file
+void collectMetrics(stream_stats::MetricsText& metrics, stream_stats::RollingRate& presented, double now) {
+    size_t queueDepth;
+    {
+        std::lock_guard<std::mutex> lock(frameQueueMutex);
+        queueDepth = frameQueue.size();
+    }
 
+    std::lock_guard<std::mutex> lock(health.mutex);
+    double expected = health.expectedPackets.PerSecond(now);
+    double received = health.receivedPackets.PerSecond(now);
+    metrics.Add("receiver_frames_fps", health.frames.PerSecond(now));
+    metrics.Add("receiver_lost_fps", health.evictedFrames.PerSecond(now));
+    metrics.Add("receiver_presented_fps", presented.PerSecond(now));
+    metrics.Add("receiver_kbps", health.bytes.PerSecond(now) * 8.0 / 1000.0);
+    metrics.Add("receiver_loss", expected > 0.0 ? std::max(0.0, 1.0 - received / expected) : 0.0);
+    metrics.Add("receiver_decode_ms_p50", health.decodeMs.Percentile(0.5));
+    metrics.Add("receiver_decode_ms_p99", health.decodeMs.Percentile(0.99));
+    metrics.Add("receiver_frame_queue_depth", (double)queueDepth);
+    metrics.Add("receiver_reassembly_pending", (double)pendingFrameCount.load());
+    if (prediction.enabled) {
+        metrics.Add("receiver_prediction_correction_p50", prediction.correction.Percentile(0.5));
+        metrics.Add("receiver_prediction_correction_p99", prediction.correction.Percentile(0.99));
+    }
+}
+
+// One line per metric in the top left corner, SDL's built-in 8x8 font
+void drawOverlay(SDL_Renderer* renderer, const stream_stats::MetricsText& metrics) {
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    const std::string& text = metrics.Text();
+    float y = 8.0f;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        SDL_RenderDebugText(renderer, 8.0f, y, text.substr(start, end - start).c_str());
+        y += 10.0f;
+        start = end + 1;
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+
+// Top right: the walls around the predicted player, the player with its heading, and the
+// last authoritative position as an outline. Forward is up, the player's right is right.
+void drawPrediction(SDL_Renderer* renderer, const Prediction& p, int windowWidth) {
+    const int radius = 7; // tiles around the player
+    const float tilePixels = 8.0f;
+    float size = (2 * radius + 1) * tilePixels;
+    float left = windowWidth - size - 8.0f, top = 8.0f;
+    float scale = tilePixels / p.grid.GetSpacing();
+    // yaw 0 faces +y with -x on its right, so x is mirrored
+    auto screenX = [&](float x) { return left + size / 2 - (x - p.state.x) * scale; };
+    auto screenY = [&](float y) { return top + size / 2 - (y - p.state.y) * scale; };
+    auto fillClipped = [&](float x0, float y0, float x1, float y1) {
+        x0 = std::max(x0, left); y0 = std::max(y0, top);
+        x1 = std::min(x1, left + size); y1 = std::min(y1, top + size);
+        if (x0 >= x1 || y0 >= y1) return;
+        SDL_FRect rect{x0, y0, x1 - x0, y1 - y0};
+        SDL_RenderFillRect(renderer, &rect);
+    };
+
+    SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
+    fillClipped(left, top, left + size, top + size);
+
+    int col, row;
+    p.grid.WorldToTile(p.state.x, p.state.y, col, row);
+    SDL_SetRenderDrawColor(renderer, 160, 160, 160, 255);
+    for (int r = row - radius - 1; r <= row + radius + 1; ++r) {
+        for (int c = col - radius - 1; c <= col + radius + 1; ++c) {
+            if (!p.grid.IsWall(c, r)) continue;
+            float x, y;
+            p.grid.TileCenter(c, r, x, y);
+            fillClipped(screenX(x) - tilePixels / 2, screenY(y) - tilePixels / 2, screenX(x) + tilePixels / 2, screenY(y) + tilePixels / 2);
+        }
+    }
+
+    float playerPixels = SIM_PLAYER_RADIUS * scale;
+    float offset = std::max(std::fabs(p.authoritative.x - p.state.x), std::fabs(p.authoritative.y - p.state.y));
+    if (offset < radius * p.grid.GetSpacing()) {
+        SDL_SetRenderDrawColor(renderer, 255, 64, 64, 255);
+        SDL_FRect authoritative{screenX(p.authoritative.x) - playerPixels, screenY(p.authoritative.y) - playerPixels, playerPixels * 2, playerPixels * 2};
+        SDL_RenderRect(renderer, &authoritative);
+    }
+
+    float centerX = screenX(p.state.x), centerY = screenY(p.state.y);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    fillClipped(centerX - playerPixels, centerY - playerPixels, centerX + playerPixels, centerY + playerPixels);
+    SDL_RenderLine(renderer, centerX, centerY, screenX(p.state.x - std::sin(p.state.yaw)), screenY(p.state.y + std::cos(p.state.yaw)));
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+
+// The last video frame with the overlays on top
+void renderView(SDL_Renderer* renderer, SDL_Texture* texture, const stream_stats::MetricsText* metrics, int windowWidth) {
+    SDL_RenderClear(renderer);
+    SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+    if (metrics) drawOverlay(renderer, *metrics);
+    if (prediction.enabled) drawPrediction(renderer, prediction, windowWidth);
+    SDL_RenderPresent(renderer);
+}
+
+// Reports go to the game's control port, it picks our simulcast layer from the loss. The
+// game only streams to receivers that report, so the first one goes out right away.
+void reportLoop(uint16_t videoPort) {
+    const int interval_seconds = 2;
+    while (running.load()) {
         ReceiverReport report;
+        report.type = PACKET_RECEIVER_REPORT;
+        report.video_port = videoPort;
         report.timestamp = static_cast<double>(SDL_GetTicks()) / 1000.0;
         report.bytes_received = total_bytes.exchange(0);
         report.expected_packets = expected_packet_count.exchange(0);
         report.received_packets = received_packet_count.exchange(0);
         report.frame_rate = decoded_frame_count.exchange(0) / (float)interval_seconds;
 
-        sendto(reportSock, reinterpret_cast<char*>(&report), sizeof(report), 0,
-               reinterpret_cast<sockaddr*>(&senderAddr), sizeof(senderAddr));
+        sendto(controlSocket, reinterpret_cast<char*>(&report), sizeof(report), 0,
+               reinterpret_cast<sockaddr*>(&gameAddr), sizeof(gameAddr));
+
+        std::this_thread::sleep_for(std::chrono::seconds(interval_seconds));
     }
 }
 
-int main() {
+// receiver [videoPort [gamePort]] [--headless] [--seconds N] [--predict MAP] [--record FILE | --replay FILE [--max-speed]]
+int main(int argc, char** argv) {
     if (startWinsock() != 0) return -1;
 
-    SOCKET sock = socket(AF_INET6, SOCK_DGRAM, 0);
-    if (sock == INVALID_SOCKET) return -1;
-    u_long mode = 1;
-    ioctlsocket(sock, FIONBIO, &mode);
+    std::vector<const char*> positional;
+    bool headless = false;     // decode without a window, e.g. for benchmarks with headless_sender
+    double runSeconds = 0.0;   // 0: until closed
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    bool maxSpeed = false;
+    const char* predictMap = nullptr; // the game's map, enables client-side prediction
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) headless = true;
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) runSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+        else if (strcmp(argv[i], "--max-speed") == 0) maxSpeed = true;
+        else if (strcmp(argv[i], "--predict") == 0 && i + 1 < argc) predictMap = argv[++i];
+        else positional.push_back(argv[i]);
+    }
 
-    sockaddr_in6 addr{};
-    addr.sin6_family = AF_INET6;
-    addr.sin6_port = htons(9999);
-    addr.sin6_addr = in6addr_any;
-    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) return -1;
+    // several receivers on one machine need their own video port
+    uint16_t videoPort = positional.size() > 0 ? static_cast<uint16_t>(atoi(positional[0])) : DEFAULT_VIDEO_PORT;
+    // a different game port puts a proxy like netsim in between
+    uint16_t gamePort = positional.size() > 1 ? static_cast<uint16_t>(atoi(positional[1])) : DEFAULT_GAME_PORT;
+
+    DatagramSource source;
+    PacketLogWriter recorder;
+    PacketLogReader replay;
+    if (replayPath) {
+        if (!replay.open(replayPath)) {
+            std::cerr << "Could not open packet log " << replayPath << "\n";
+            return -1;
+        }
+        source.replay = &replay;
+        source.replayMaxSpeed = maxSpeed;
+    } else {
+        source.sock = socket(AF_INET6, SOCK_DGRAM, 0);
+        if (source.sock == INVALID_SOCKET) return -1;
+        u_long mode = 1;
+        ioctlsocket(source.sock, FIONBIO, &mode);
+
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(videoPort);
+        addr.sin6_addr = in6addr_any;
+        if (bind(source.sock, (sockaddr*)&addr, sizeof(addr)) != 0) return -1;
+
+        if (recordPath) {
+            if (!recorder.open(recordPath)) {
+                std::cerr << "Could not create packet log " << recordPath << "\n";
+                return -1;
+            }
+            source.recorder = &recorder;
+        }
+    }
+
+    if (predictMap) {
+        int chunkSize;
+        if (!LoadMapGrid(predictMap, prediction.grid, chunkSize)) {
+            std::cerr << "Could not open map " << predictMap << "\n";
+            return -1;
+        }
+        prediction.enabled = true;
+    }
 
     const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
     AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
     avcodec_open2(codecCtx, codec, nullptr);
 
-    std::thread(reportLoop, sock, addr).detach();
-    std::thread decoderThread(decode_thread_func, sock, codecCtx);
+    std::thread decoderThread(decode_thread_func, source, codecCtx);
 
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_Texture* texture = nullptr;
-    SDL_Init(SDL_INIT_VIDEO);
+    int textureWidth = 0, textureHeight = 0;
+    int windowWidth = 0;
+    if (!headless) SDL_Init(SDL_INIT_VIDEO);
 
-    if (!initControlSocket()) {
+    if (!initControlSocket(gamePort)) {
         std::cerr << "Failed to initialize control socket\n";
         return -1;
     }
+    if (!replayPath) std::thread(reportLoop, videoPort).detach();
+
+    TRACE_THREAD_NAME("main");
+    stream_stats::RollingRate presentedFrames;
+    stream_stats::MetricsText metrics;
+    stream_stats::MetricsFileWriter metricsWriter("receiver_metrics_" + std::to_string(videoPort) + ".txt");
+    double lastMetricsUpdate = 0.0;
+    bool showOverlay = true; // F3 toggles
+    double startTime = nowSeconds();
+    uint64_t presentedTotal = 0;
 
     SDL_Event e;
     while (running.load()) {
-        while (SDL_PollEvent(&e)) {
+        if (runSeconds > 0.0 && nowSeconds() - startTime >= runSeconds) {
+            running.store(false);
+            break;
+        }
+        if (replayDone.load()) {
+            std::lock_guard<std::mutex> lock(frameQueueMutex);
+            if (frameQueue.empty()) {
+                running.store(false);
+                break;
+            }
+        }
+
+        float mouseDx = 0.0f, mouseDy = 0.0f;
+        while (!headless && SDL_PollEvent(&e)) {
             if (e.type == SDL_EVENT_QUIT ||
                 (e.type == SDL_EVENT_KEY_DOWN && e.key.scancode == SDL_SCANCODE_ESCAPE)) {
                 running.store(false);
                 frameQueueCondVar.notify_all();
                 break;
             }
-            float dt = 0.033f; // Assume fixed timestep or calculate dynamically
-            if (e.type == SDL_EVENT_KEY_DOWN) {
-                sendKeyToGame(e.key.scancode, dt);
+            if (e.type == SDL_EVENT_KEY_DOWN && !e.key.repeat && e.key.scancode == SDL_SCANCODE_F3) {
+                showOverlay = !showOverlay;
+            } else if (e.type == SDL_EVENT_KEY_DOWN && !e.key.repeat) {
+                onKeyEdge(e.key.scancode, true);
+            } else if (e.type == SDL_EVENT_KEY_UP) {
+                onKeyEdge(e.key.scancode, false);
+            } else if (e.type == SDL_EVENT_MOUSE_MOTION && (e.motion.state & SDL_BUTTON_LMASK)) {
+                mouseDx += e.motion.xrel;
+                mouseDy += e.motion.yrel;
             }
         }
+        // one packet per poll round instead of one per motion event
+        if (mouseDx != 0.0f || mouseDy != 0.0f) {
+            sendInputToGame(static_cast<int16_t>(mouseDx), static_cast<int16_t>(mouseDy));
+            prediction.mouseDx += static_cast<int16_t>(mouseDx);
+        } else if ((keyState || trailingPackets > 0) && SDL_GetTicks() - lastInputSendMs >= INPUT_HEARTBEAT_MS) {
+            if (!keyState) trailingPackets--;
+            sendInputToGame();
+        }
+
+        double now = nowSeconds();
+        if (prediction.enabled) updatePrediction(prediction, now);
+        if (now - lastMetricsUpdate >= METRICS_INTERVAL) {
+            metrics.Clear();
+            collectMetrics(metrics, presentedFrames, now);
+            metricsWriter.Publish(metrics);
+            lastMetricsUpdate = now;
+        }
 
         std::unique_lock<std::mutex> lock(frameQueueMutex);
-        if (!frameQueue.empty()) {
+        if (headless) {
+            // frames count as presented once they leave the queue
+            frameQueueCondVar.wait_for(lock, std::chrono::milliseconds(5), [] { return !frameQueue.empty(); });
+            std::queue<DecodedFrame> frames;
+            frames.swap(frameQueue);
+            lock.unlock();
+            frameQueueCondVar.notify_all(); // a replay may wait for room
+
+            while (!frames.empty()) {
+                double presented = nowSeconds();
+                presentedFrames.Add(1.0, presented);
+                presentedTotal++;
+                if (frames.front().traced) recordLatency(frames.front().latency, presented);
+                frames.pop();
+            }
+        } else if (!frameQueue.empty()) {
             auto frame = std::move(frameQueue.front());
             frameQueue.pop();
             lock.unlock();
+            frameQueueCondVar.notify_all(); // a replay may wait for room
 
             if (!isSDLInitialized) {
                 window = SDL_CreateWindow("Receiver", frame.width, frame.height, 0);
+                windowWidth = frame.width;
                 renderer = SDL_CreateRenderer(window, nullptr);
-                texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, frame.width, frame.height);
                 isSDLInitialized = true;
             }
 
-            SDL_UpdateTexture(texture, nullptr, frame.rgba.data(), frame.width * 4);
-            SDL_RenderClear(renderer);
-            SDL_RenderTexture(renderer, texture, nullptr, nullptr);
-            SDL_RenderPresent(renderer);
+            // the sender scales its resolution with the available bitrate, the window keeps
+            // its size and the texture is stretched over it
+            if (!texture || frame.width != textureWidth || frame.height != textureHeight) {
+                if (texture) SDL_DestroyTexture(texture);
+                texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, frame.width, frame.height);
+                SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_LINEAR);
+                textureWidth = frame.width;
+                textureHeight = frame.height;
+            }
+
+            {
+                TRACE_SCOPE("present");
+                SDL_UpdateTexture(texture, nullptr, frame.rgba.data(), frame.width * 4);
+                renderView(renderer, texture, showOverlay ? &metrics : nullptr, windowWidth);
+            }
+            presentedFrames.Add(1.0, nowSeconds());
+            if (frame.traced) recordLatency(frame.latency, nowSeconds());
             std::this_thread::sleep_for(std::chrono::milliseconds(33));
         } else {
             lock.unlock();
+            // the video only changes with the next frame, the prediction with every tick
+            if (prediction.enabled && texture) renderView(renderer, texture, showOverlay ? &metrics : nullptr, windowWidth);
             std::this_thread::sleep_for(std::chrono::milliseconds(5));
         }
     }
 
 
+    frameQueueCondVar.notify_all();
     decoderThread.join();
+    TRACE_WRITE("trace_receiver.json", "receiver");
+    if (headless) {
+        double elapsed = nowSeconds() - startTime;
+        std::cout << presentedTotal << " frames in " << elapsed << " s (" << presentedTotal / elapsed << " fps)\n";
+        metrics.Clear();
+        collectMetrics(metrics, presentedFrames, nowSeconds());
+        std::cout << metrics.Text();
+        printLatencySummary();
+    }
+    if (replayPath) printf("replay checksum %016llx\n", (unsigned long long)replayChecksum);
+    if (recordPath) {
+        std::cout << "Recorded " << recorder.getRecords() << " datagrams to " << recordPath << "\n";
+        recorder.close();
+    }
     avcodec_free_context(&codecCtx);
     if (texture) SDL_DestroyTexture(texture);
     if (renderer) SDL_DestroyRenderer(renderer);
     if (window) SDL_DestroyWindow(window);
-    SDL_Quit();
-    closesocket(sock);
+    if (!headless) SDL_Quit();
+    if (source.sock != INVALID_SOCKET) closesocket(source.sock);
     WSACleanup();
     return 0;
 }
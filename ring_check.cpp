@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "frame_ring.h"
+
+// Feeds the raw recording ring (frame_ring.h) from a producer at the game's frame rate
+// into a sink slower than that, once with each overflow policy, and checks what the game
+// relies on: Drop never stalls the producer and counts every frame it discards, Block
+// loses nothing, the sink sees the kept frames in order and intact, and the high-water
+// mark never passes the ring size. Builds without the engine or ffmpeg:
+//
+//   g++ -std=c++17 -O2 ring_check.cpp -o ring_check -pthread
+//   ring_check --frames 120 --fps 60 --sink-ms 25 --ring 8
+
+struct CheckResult {
+    uint64_t written = 0;   // WriteFrame returned true
+    uint64_t dropped = 0;   // GetDroppedFrames
+    uint64_t received = 0;  // frames the sink saw
+    uint64_t outOfOrder = 0;
+    uint64_t corrupt = 0;
+    size_t highWaterMark = 0;
+    double slowestWriteMs = 0.0;
+    double seconds = 0.0;
+};
+
+// Every byte of frame n is derived from n, so the sink can tell which frame it got
+// and whether the slot was overwritten while it was being written
+uint8_t frameByte(uint32_t frame, size_t offset) {
+    return static_cast<uint8_t>(frame * 31u + offset * 7u);
+}
+
+CheckResult runPolicy(FrameRing::OverflowPolicy policy, int frames, double fps, int sinkMs, size_t ringSize, size_t frameSize) {
+    CheckResult result;
+    int64_t lastFrame = -1;
+
+    auto sink = [&](const uint8_t* data, size_t size) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(sinkMs));
+
+        uint32_t frame;
+        memcpy(&frame, data, sizeof(frame));
+        for (size_t i = sizeof(frame); i < size; ++i) {
+            if (data[i] != frameByte(frame, i)) {
+                result.corrupt++;
+                break;
+            }
+        }
+        if ((int64_t)frame <= lastFrame) result.outOfOrder++;
+        lastFrame = frame;
+        result.received++;
+    };
+
+    std::vector<uint8_t> frame(frameSize);
+    auto interval = std::chrono::duration<double>(1.0 / fps);
+    auto start = std::chrono::steady_clock::now();
+    {
+        FrameRing ring(frameSize, sink, policy, ringSize, "ring_check sink");
+        for (int n = 0; n < frames; ++n) {
+            uint32_t id = static_cast<uint32_t>(n);
+            memcpy(frame.data(), &id, sizeof(id));
+            for (size_t i = sizeof(id); i < frameSize; ++i) frame[i] = frameByte(id, i);
+
+            auto before = std::chrono::steady_clock::now();
+            if (ring.WriteFrame(frame.data())) result.written++;
+            double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count();
+            result.slowestWriteMs = std::max(result.slowestWriteMs, writeMs);
+
+            std::this_thread::sleep_until(start + interval * (n + 1));
+        }
+        result.dropped = ring.GetDroppedFrames();
+        result.highWaterMark = ring.GetHighWaterMark();
+    } // the destructor hands the rest of the queue to the sink
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+bool check(bool ok, const char* what) {
+    printf("  %-54s %s\n", what, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+void printUsage() {
+    std::cerr << "usage: ring_check [options]\n"
+                 "  --frames N     frames the producer writes (120)\n"
+                 "  --fps N        producer frame rate (60)\n"
+                 "  --sink-ms N    time the sink takes per frame, above 1000/fps (25)\n"
+                 "  --ring N       ring slots (8)\n"
+                 "  --size N       frame size in bytes (1280*720*4)\n";
+}
+
+int main(int argc, char** argv) {
+    int frames = 120, sinkMs = 25;
+    double fps = 60.0;
+    size_t ringSize = 8, frameSize = size_t(1280) * 720 * 4;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() { return ++i < argc ? argv[i] : "0"; };
+
+        if (arg == "--frames") frames = atoi(next());
+        else if (arg == "--fps") fps = atof(next());
+        else if (arg == "--sink-ms") sinkMs = atoi(next());
+        else if (arg == "--ring") ringSize = strtoull(next(), nullptr, 10);
+        else if (arg == "--size") frameSize = strtoull(next(), nullptr, 10);
+        else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (frames <= 0 || fps <= 0.0 || sinkMs <= 1000.0 / fps || ringSize == 0 || frameSize < sizeof(uint32_t)) {
+        printUsage();
+        return -1;
+    }
+
+    double frameMs = 1000.0 / fps;
+    printf("%d frames of %zu bytes at %.0f fps, sink %d ms per frame, %zu slots\n", frames, frameSize, fps, sinkMs, ringSize);
+    bool ok = true;
+
+    CheckResult drop = runPolicy(FrameRing::OverflowPolicy::Drop, frames, fps, sinkMs, ringSize, frameSize);
+    printf("drop: %llu written, %llu dropped, %llu received, high-water mark %zu, slowest write %.2f ms, %.2f s\n",
+           (unsigned long long)drop.written, (unsigned long long)drop.dropped, (unsigned long long)drop.received,
+           drop.highWaterMark, drop.slowestWriteMs, drop.seconds);
+    ok &= check(drop.dropped > 0, "frames are dropped when the sink falls behind");
+    ok &= check(drop.written + drop.dropped == (uint64_t)frames, "every frame is either written or counted as dropped");
+    ok &= check(drop.received == drop.written, "every written frame reaches the sink");
+    ok &= check(drop.highWaterMark == ringSize, "the queue fills up to the ring size and no further");
+    ok &= check(drop.slowestWriteMs < frameMs, "the producer never waits a frame on the sink");
+    ok &= check(drop.outOfOrder == 0 && drop.corrupt == 0, "frames arrive in order and intact");
+
+    CheckResult block = runPolicy(FrameRing::OverflowPolicy::Block, frames, fps, sinkMs, ringSize, frameSize);
+    printf("block: %llu written, %llu dropped, %llu received, high-water mark %zu, slowest write %.2f ms, %.2f s\n",
+           (unsigned long long)block.written, (unsigned long long)block.dropped, (unsigned long long)block.received,
+           block.highWaterMark, block.slowestWriteMs, block.seconds);
+    ok &= check(block.dropped == 0 && block.received == (uint64_t)frames, "no frame is dropped");
+    ok &= check(block.highWaterMark == ringSize, "the queue fills up to the ring size and no further");
+    ok &= check(block.slowestWriteMs >= sinkMs * 0.5, "the producer waits for the sink once the ring is full");
+    ok &= check(block.outOfOrder == 0 && block.corrupt == 0, "frames arrive in order and intact");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "player_sim.h"
+
+// Runs the game's player simulation (player_sim.h) without the engine: many players on a
+// generated room map, each driven by its own scripted keys, for a fixed number of ticks.
+// Reports ticks per second and runs everything twice, the final states must match bit
+// for bit. Builds without the engine:
+//
+//   g++ -std=c++17 -O2 sim_bench.cpp -o sim_bench
+//   sim_bench --players 1000 --ticks 3600 --size 512
+
+// xorshift64*, the same scripts on every platform
+class BenchRandom {
+public:
+    explicit BenchRandom(uint64_t seed) : state(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+
+private:
+    uint64_t state;
+};
+
+// Rooms of `room` tiles with a door in the middle of every wall
+std::vector<std::string> makeRooms(int size, int room) {
+    std::vector<std::string> rows(size, std::string(size, '.'));
+    for (int row = 0; row < size; ++row) {
+        for (int col = 0; col < size; ++col) {
+            bool wallRow = row % room == 0 || row == size - 1;
+            bool wallCol = col % room == 0 || col == size - 1;
+            bool door = (wallRow && col % room == room / 2) || (wallCol && row % room == room / 2);
+            if ((wallRow || wallCol) && !door) rows[row][col] = '#';
+        }
+    }
+    return rows;
+}
+
+// Holds a random key combination for a random number of ticks, like a player would
+struct KeyScript {
+    BenchRandom random;
+    uint16_t keys = 0;
+    int ticksLeft = 0;
+
+    explicit KeyScript(uint64_t seed) : random(seed) {}
+
+    uint16_t next() {
+        if (ticksLeft-- <= 0) {
+            keys = static_cast<uint16_t>(random.next() >> 58); // W S A D LEFT RIGHT
+            ticksLeft = static_cast<int>(random.next() % 90);
+        }
+        return keys;
+    }
+};
+
+struct RunResult {
+    uint64_t checksum = 0;
+    uint64_t collisions = 0;
+    double seconds = 0.0;
+};
+
+RunResult runPlayers(const CollisionGrid& grid, int players, int ticks, uint64_t seed) {
+    std::vector<PlayerSimState> states(players);
+    std::vector<KeyScript> scripts;
+    scripts.reserve(players);
+
+    BenchRandom spawnRandom(seed);
+    for (int i = 0; i < players; ++i) {
+        grid.PickWalkable([&]() { return static_cast<uint32_t>(spawnRandom.next() >> 34); },
+                          0.0f, 0.0f, 0.0f, 0.0f, states[i].x, states[i].y);
+        scripts.emplace_back(seed + 1 + i);
+    }
+
+    RunResult result;
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        for (int i = 0; i < players; ++i) {
+            if (StepPlayer(states[i], scripts[i].next(), static_cast<float>(SIM_TICK_SECONDS), grid)) result.collisions++;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // FNV-1a over the raw floats, any difference in any bit shows
+    result.checksum = 1469598103934665603ull;
+    for (auto& state : states) {
+        float values[4] = { state.x, state.y, state.z, state.yaw };
+        uint8_t bytes[sizeof(values)];
+        memcpy(bytes, values, sizeof(values));
+        for (uint8_t byte : bytes) result.checksum = (result.checksum ^ byte) * 1099511628211ull;
+    }
+    return result;
+}
+
+void printUsage() {
+    std::cerr << "usage: sim_bench [options]\n"
+                 "  --players N  simulated players (1000)\n"
+                 "  --ticks N    ticks to run, 60 per simulated second (3600)\n"
+                 "  --size N     map side in tiles (512)\n"
+                 "  --room N     room side in tiles (12)\n"
+                 "  --seed N     seed for spawns and key scripts (1)\n";
+}
+
+int main(int argc, char** argv) {
+    int players = 1000, ticks = 3600, size = 512, room = 12;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() { return ++i < argc ? argv[i] : "0"; };
+
+        if (arg == "--players") players = atoi(next());
+        else if (arg == "--ticks") ticks = atoi(next());
+        else if (arg == "--size") size = atoi(next());
+        else if (arg == "--room") room = atoi(next());
+        else if (arg == "--seed") seed = strtoull(next(), nullptr, 10);
+        else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (players <= 0 || ticks <= 0 || size < 3 || room < 2) {
+        printUsage();
+        return -1;
+    }
+
+    CollisionGrid grid;
+    grid.Build(makeRooms(size, room));
+
+    RunResult first = runPlayers(grid, players, ticks, seed);
+    RunResult second = runPlayers(grid, players, ticks, seed);
+    double playerTicks = double(players) * ticks;
+
+    printf("%d players x %d ticks (%.0f simulated s) on %dx%d tiles\n", players, ticks, ticks * SIM_TICK_SECONDS, size, size);
+    printf("  %.2f M player ticks/s, %.3f ms per tick of all players, %llu collisions\n",
+           playerTicks / first.seconds / 1e6, first.seconds * 1000.0 / ticks, (unsigned long long)first.collisions);
+    printf("  checksum %016llx / %016llx: %s\n", (unsigned long long)first.checksum, (unsigned long long)second.checksum,
+           first.checksum == second.checksum && first.collisions == second.collisions ? "deterministic" : "MISMATCH");
+    return first.checksum == second.checksum ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+// Asynchronous logging for the game and the receiver. The calling thread only checks
+// the level, formats into a fixed record and pushes it into a lock-free queue; a
+// background thread writes the records to stdout/stderr. Call sites on hot paths (per
+// packet, per key, per frame) use the _LIMITED macros; their suppressed messages are
+// counted and reported with the next one that passes. If the queue is full the record
+// is dropped instead of blocking the caller. Results that must appear whole and in
+// order with other output (benchmark and latency summaries) go to stdout directly.
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "mpsc_queue.h"
+
+namespace stream_log {
+
+    enum class Level : uint8_t { Debug, Info, Warn, Error };
+
+    struct Record {
+        Level level;
+        char text[240];
+    };
+
+    // Per call site token window, allows `perSecond` messages in every second
+    class RateLimit {
+        public:
+            explicit RateLimit(uint32_t perSecond) : m_perSecond(perSecond) {}
+
+            // Returns false if the message should be suppressed; `suppressed` receives the
+            // number of messages swallowed since the last one that passed
+            bool Allow(uint32_t& suppressed) {
+                uint64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                uint64_t window = m_window.load(std::memory_order_relaxed);
+                if (second != window && m_window.compare_exchange_strong(window, second)) {
+                    m_count.store(0, std::memory_order_relaxed);
+                }
+                if (m_count.fetch_add(1, std::memory_order_relaxed) >= m_perSecond) {
+                    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+                return true;
+            }
+
+        private:
+            uint32_t m_perSecond;
+            std::atomic<uint64_t> m_window{0};
+            std::atomic<uint32_t> m_count{0};
+            std::atomic<uint32_t> m_suppressed{0};
+    };
+
+    class Logger {
+        public:
+            static constexpr size_t QUEUE_SIZE = 1024;
+
+            static Logger& Get() {
+                static Logger logger;
+                return logger;
+            }
+
+            ~Logger() {
+                m_running = false;
+                if (m_thread.joinable()) m_thread.join();
+            }
+
+            void SetLevel(Level level) { m_level.store(level, std::memory_order_relaxed); }
+            bool Enabled(Level level) const { return level >= m_level.load(std::memory_order_relaxed); }
+
+            void Write(Level level, uint32_t suppressed, const char* format, ...) {
+                Record record;
+                record.level = level;
+
+                va_list args;
+                va_start(args, format);
+                int length = vsnprintf(record.text, sizeof(record.text), format, args);
+                va_end(args);
+
+                if (suppressed > 0 && length >= 0 && length < (int)sizeof(record.text)) {
+                    snprintf(record.text + length, sizeof(record.text) - length, " (%u similar suppressed)", suppressed);
+                }
+
+                if (!m_queue.TryPush(record)) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+        private:
+            Logger() : m_thread(&Logger::Run, this) {}
+
+            void Run() {
+                while (true) {
+                    bool running = m_running.load();
+                    Flush();
+                    if (!running) break;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+
+            void Flush() {
+                static const char* names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+                Record record;
+                bool wrote = false;
+                while (m_queue.TryPop(record)) {
+                    FILE* out = record.level >= Level::Warn ? stderr : stdout;
+                    fprintf(out, "[%s] %s\n", names[(int)record.level], record.text);
+                    wrote = true;
+                }
+
+                uint32_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0) {
+                    fprintf(stderr, "[WARN] log queue full, %u messages dropped\n", dropped);
+                    wrote = true;
+                }
+                if (wrote) {
+                    fflush(stdout);
+                    fflush(stderr);
+                }
+            }
+
+            std::atomic<Level> m_level{Level::Info};
+            std::atomic<uint32_t> m_dropped{0};
+            std::atomic<bool> m_running{true};
+            MPSCQueue<Record, QUEUE_SIZE> m_queue;
+            std::thread m_thread; // last, starts after the queue exists
+    };
+
+} // namespace stream_log
+
+#define STREAM_LOG(level, ...)                                                     \
+    do {                                                                           \
+        if (::stream_log::Logger::Get().Enabled(level)) {                          \
+            ::stream_log::Logger::Get().Write(level, 0, __VA_ARGS__);              \
+        }                                                                          \
+    } while (0)
+
+#define STREAM_LOG_RATE(level, perSecond, ...)                                              \
+    do {                                                                                    \
+        if (::stream_log::Logger::Get().Enabled(level)) {                                   \
+            static ::stream_log::RateLimit streamLogLimit_(perSecond);                      \
+            uint32_t streamLogSuppressed_ = 0;                                              \
+            if (streamLogLimit_.Allow(streamLogSuppressed_)) {                              \
+                ::stream_log::Logger::Get().Write(level, streamLogSuppressed_, __VA_ARGS__); \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+// printf style
+#define LOG_DEBUG(...) STREAM_LOG(::stream_log::Level::Debug, __VA_ARGS__)
+#define LOG_INFO(...)  STREAM_LOG(::stream_log::Level::Info, __VA_ARGS__)
+#define LOG_WARN(...)  STREAM_LOG(::stream_log::Level::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) STREAM_LOG(::stream_log::Level::Error, __VA_ARGS__)
+
+// for hot paths; each call site may log 20 messages per second
+#define LOG_DEBUG_LIMITED(...) STREAM_LOG_RATE(::stream_log::Level::Debug, 20, __VA_ARGS__)
+#define LOG_INFO_LIMITED(...)  STREAM_LOG_RATE(::stream_log::Level::Info, 20, __VA_ARGS__)
+#define LOG_WARN_LIMITED(...)  STREAM_LOG_RATE(::stream_log::Level::Warn, 20, __VA_ARGS__)
+#define LOG_ERROR_LIMITED(...) STREAM_LOG_RATE(::stream_log::Level::Error, 20, __VA_ARGS__)
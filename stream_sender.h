@@ -0,0 +1,362 @@
+#pragma once
+
+// The streaming half of the game without the engine: fragmenting UDP sender, frame
+// pacing and the H.264 encoder. Shared by game.cpp and headless_sender.cpp.
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+    #include <libavutil/imgutils.h>
+    #include <libavutil/opt.h>
+    #include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+#include "net_compat.h"
+#include "stream_log.h"
+#include "stream_trace.h"
+#include "stream_transport.h"
+
+// Prefixed to every encoded frame for input-to-photon tracing. Times are the game's
+// steady clock in seconds; input_timestamp is the receiver's clock echoed back.
+#pragma pack(push, 1)
+struct FrameMeta {
+    int64_t  pts;
+    uint32_t input_sequence; // 0 if no new input was applied before this capture
+    double   input_timestamp;
+    double   input_arrival;
+    double   capture_start;
+    double   capture_end;
+    double   encode_end;
+};
+#pragma pack(pop)
+
+// steady_clock in seconds, the same clock the fragment headers use
+inline double SteadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class UDPsend {
+    public:
+        int sock = 0;
+        struct sockaddr_in6 addr;
+        unsigned int packetnum = 0;
+
+        static constexpr int MTU = FRAGMENT_MTU;
+        static constexpr int HEADER_SIZE = FRAGMENT_HEADER_SIZE;
+        static constexpr int MAX_PAYLOAD = FRAGMENT_MAX_PAYLOAD;
+
+        UDPsend() {};
+
+        ~UDPsend() {};
+
+        void init(const char *address, int port) {
+            sock = socket( AF_INET6, SOCK_DGRAM, 0);
+            struct addrinfo hints;
+
+            memset(&addr, 0, sizeof(addr));
+            memset(&hints, 0, sizeof(hints));
+
+            hints.ai_family = AF_INET6;
+            hints.ai_socktype = SOCK_DGRAM;
+            hints.ai_flags = 0;
+
+            struct addrinfo *result = NULL;
+            auto dwRetval = getaddrinfo(address, nullptr, &hints, &result);
+            if ( dwRetval != 0 ) {
+                printf("getaddrinfo failed with error: %d\n", dwRetval);
+                return;
+            }
+            for (addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+                if (ptr->ai_family == AF_INET6) {
+                    memcpy(&addr, ptr->ai_addr, ptr->ai_addrlen);
+                    addr.sin6_port = htons(port);
+                    addr.sin6_family = AF_INET6;
+                }
+            }
+            freeaddrinfo(result);
+        };
+
+        void init(const sockaddr_in6& destination) {
+            sock = socket(AF_INET6, SOCK_DGRAM, 0);
+            addr = destination;
+        }
+        
+
+        int send_fragmented(char* buffer, int len) {
+            TRACE_SCOPE("send_fragmented");
+            packetnum++; // new frame ID
+
+            int index = 0;
+            return FragmentFrame(buffer, len, packetnum, [&](const char* datagram, int size) {
+                int ret = sendto(sock, datagram, size, 0, (const sockaddr*)&addr, sizeof(addr));
+                if (ret < 0) LOG_ERROR("Failed to send fragment %d", index);
+                index++;
+                return ret;
+            });
+        }
+
+        // One datagram outside the frames, see BuildMessage
+        int send_message(uint16_t type, uint32_t id, const void* payload, int size) {
+            char datagram[MTU];
+            int datagramSize = BuildMessage(datagram, type, id, payload, size);
+            if (datagramSize < 0) return -1;
+            int ret = sendto(sock, datagram, datagramSize, 0, (const sockaddr*)&addr, sizeof(addr));
+            if (ret < 0) LOG_ERROR("Failed to send message %u", (unsigned)type);
+            return ret;
+        }
+        
+        void closeSock() {
+            closesocket(sock);
+            sock=0;
+        };
+};
+
+class FrameLimiter {
+    public:
+    FrameLimiter(float targetFPS)
+    : m_frameDuration
+        (
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>
+            (
+            std::chrono::duration<float>(1.0f / targetFPS)
+            )
+        ),
+    m_nextFrameTime
+        (
+        std::chrono::steady_clock::now()
+        ) {}
+
+    
+        void Wait() {
+            auto now = std::chrono::steady_clock::now();
+    
+            if (now < m_nextFrameTime) {
+                std::this_thread::sleep_until(m_nextFrameTime);
+            }
+    
+            m_nextFrameTime += m_frameDuration;
+        }
+    
+    private:
+        std::chrono::steady_clock::duration m_frameDuration;
+        std::chrono::steady_clock::time_point m_nextFrameTime;
+};
+    
+struct DirtyRegion {
+    bool changed = true;
+    int left = 0, top = 0, right = 0, bottom = 0; // pixel bounds, right/bottom exclusive
+    float fraction = 1.0f;                        // share of blocks that changed
+};
+
+class FFmpegEncoder {
+    public:
+        static constexpr int64_t BIT_RATE = 400000;
+
+        // width/height: size of the captured RGBA frames, the output defaults to the same size
+        FFmpegEncoder(int width, int height, int fps, int64_t bitRate = BIT_RATE, int outWidth = 0, int outHeight = 0) 
+            : m_srcWidth(width), m_srcHeight(height), m_fps(fps), m_bitRate(bitRate)
+        {
+            m_packet = av_packet_alloc();
+            if (!m_packet) {
+                std::cerr << "Could not allocate packet\n";
+                return;
+            }
+
+            Open(outWidth ? outWidth & ~1 : width, outHeight ? outHeight & ~1 : height);
+        }
+    
+        ~FFmpegEncoder() {
+            Close();
+            av_packet_free(&m_packet);
+        }
+
+        // Reopens the codec at the new size, the first frame after a switch is an IDR frame.
+        // Packets the old codec still holds are passed to onPacket(const AVPacket*) first.
+        template<typename OnPacket>
+        void SetOutputSize(int width, int height, OnPacket onPacket) {
+            width &= ~1; // YUV420P needs even dimensions
+            height &= ~1;
+            if (width == m_width && height == m_height) return;
+
+            Drain(onPacket);
+            Close();
+            Open(width, height);
+        }
+
+        // Flushes the codec; it takes no more frames until it is reopened
+        template<typename OnPacket>
+        void Drain(OnPacket onPacket) {
+            if (!m_codecCtx || avcodec_send_frame(m_codecCtx, nullptr) < 0) return;
+            while (avcodec_receive_packet(m_codecCtx, m_packet) >= 0) {
+                onPacket(static_cast<const AVPacket*>(m_packet));
+                av_packet_unref(m_packet);
+            }
+        }
+    
+        // Returns encoded H.264 buffer (in packet), and size
+        // roi: if set, the encoder spends more bits inside the changed region (source pixels)
+        std::pair<uint8_t*, int> EncodeFrame(const uint8_t* rgbaData, const DirtyRegion* roi = nullptr) {
+            if (!m_codecCtx || !OpenConverter()) return {nullptr, 0};
+
+            const uint8_t* srcSlice[] = { rgbaData };
+            int srcStride[] = { 4 * m_srcWidth };
+    
+            // Convert RGBA → YUV420P, rescaling to the output size
+            sws_scale(m_swsCtx, srcSlice, srcStride, 0, m_srcHeight, m_frame->data, m_frame->linesize);
+
+            return EncodePicture(m_frame, roi);
+        }
+
+        // Encodes a YUV420P picture that already has the output size (e.g. a ScalePyramid level)
+        std::pair<uint8_t*, int> EncodePicture(AVFrame* picture, const DirtyRegion* roi = nullptr) {
+            TRACE_SCOPE("EncodeFrame");
+            if (!m_codecCtx) return {nullptr, 0};
+    
+            picture->pts = m_pts++;
+            // pictures may be shared between encoders, so the type is set on every call
+            picture->pict_type = m_forceKeyFrame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+            m_forceKeyFrame = false;
+
+            av_frame_remove_side_data(picture, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+            if (roi) {
+                AVFrameSideData* sd = av_frame_new_side_data(picture, AV_FRAME_DATA_REGIONS_OF_INTEREST, sizeof(AVRegionOfInterest));
+                if (sd) {
+                    AVRegionOfInterest* r = reinterpret_cast<AVRegionOfInterest*>(sd->data);
+                    r->self_size = sizeof(AVRegionOfInterest);
+                    r->top = roi->top * m_height / m_srcHeight;
+                    r->bottom = roi->bottom * m_height / m_srcHeight;
+                    r->left = roi->left * m_width / m_srcWidth;
+                    r->right = roi->right * m_width / m_srcWidth;
+                    r->qoffset = av_make_q(-1, 5);
+                }
+            }
+    
+            // Send frame to encoder
+            int ret = avcodec_send_frame(m_codecCtx, picture);
+            if (ret < 0) return {nullptr, 0};
+    
+            ret = avcodec_receive_packet(m_codecCtx, m_packet);
+            if (ret < 0) return {nullptr, 0};
+    
+            // Return pointer and size (packet data is owned by FFmpeg)
+            return { m_packet->data, m_packet->size };
+        }
+    
+        void FreePacket() {
+            av_packet_unref(m_packet);
+        }
+
+        // The next encoded frame is an IDR frame, a receiver can start decoding from it
+        void RequestKeyFrame() {
+            m_forceKeyFrame = true;
+        }
+
+        // Keeps timestamps on the wall clock when a frame is not encoded
+        void SkipFrame() {
+            m_pts++;
+        }
+
+        const AVCodecContext* GetCodecContext() const { return m_codecCtx; }
+        const AVPacket* GetPacket() const { return m_packet; }
+        bool IsKeyFrame() const { return m_packet->flags & AV_PKT_FLAG_KEY; }
+        int64_t GetBitRate() const { return m_bitRate; }
+        int64_t GetNextPts() const { return m_pts; }
+        int GetWidth() const { return m_width; }
+        int GetHeight() const { return m_height; }
+        int GetSourceWidth() const { return m_srcWidth; }
+        int GetSourceHeight() const { return m_srcHeight; }
+    
+    private:
+        void Open(int width, int height) {
+            m_width = width;
+            m_height = height;
+
+            const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+            if (!codec) {
+                std::cerr << "Codec not found\n";
+                return;
+            }
+            m_codecCtx = avcodec_alloc_context3(codec);
+            if (!m_codecCtx) {
+                std::cerr << "Could not allocate codec context\n";
+                return;
+            }
+
+            m_codecCtx->bit_rate = m_bitRate;
+            m_codecCtx->width = m_width;
+            m_codecCtx->height = m_height;
+            m_codecCtx->time_base = {1, m_fps};
+            m_codecCtx->framerate = {m_fps, 1};
+            m_codecCtx->gop_size = 10;
+            m_codecCtx->max_b_frames = 0;
+            m_codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    
+            av_opt_set(m_codecCtx->priv_data, "annexb", "1", 0);
+            // no lookahead, B-frames or frame threads: every frame sent comes back as its
+            // packet in the same call, nothing is held back when the game stops encoding
+            av_opt_set(m_codecCtx->priv_data, "tune", "zerolatency", 0);
+            // a forced I picture (RequestKeyFrame) is an IDR frame, not just an intra frame
+            av_opt_set(m_codecCtx->priv_data, "forced-idr", "1", 0);
+
+            if (avcodec_open2(m_codecCtx, codec, NULL) < 0) {
+                std::cerr << "Could not open codec\n";
+                avcodec_free_context(&m_codecCtx);
+                return;
+            }
+        }
+
+        // Own RGBA → YUV420P conversion, only needed when frames come in through EncodeFrame
+        bool OpenConverter() {
+            if (m_swsCtx) return true;
+
+            m_frame = av_frame_alloc();
+            if (!m_frame) {
+                std::cerr << "Could not allocate frame\n";
+                return false;
+            }
+
+            m_frame->format = AV_PIX_FMT_YUV420P;
+            m_frame->width = m_width;
+            m_frame->height = m_height;
+            av_frame_get_buffer(m_frame, 32);
+    
+            // SwsContext to convert from RGBA to YUV420P
+            m_swsCtx = sws_getContext(
+                m_srcWidth, m_srcHeight, AV_PIX_FMT_RGBA,
+                m_width, m_height, AV_PIX_FMT_YUV420P,
+                SWS_BILINEAR, nullptr, nullptr, nullptr
+            );
+            if (!m_swsCtx) {
+                std::cerr << "Could not allocate SwsContext\n";
+                return false;
+            }
+            return true;
+        }
+
+        void Close() {
+            sws_freeContext(m_swsCtx);
+            m_swsCtx = nullptr;
+            av_frame_free(&m_frame);
+            avcodec_free_context(&m_codecCtx);
+        }
+
+        int m_srcWidth, m_srcHeight;
+        int m_width = 0, m_height = 0;
+        int m_fps;
+        int64_t m_bitRate;
+        int m_pts = 0;
+        bool m_forceKeyFrame = false;
+        AVCodecContext* m_codecCtx = nullptr;
+        AVFrame* m_frame = nullptr;
+        AVPacket* m_packet = nullptr;
+        SwsContext* m_swsCtx = nullptr;
+    };
@@ -0,0 +1,168 @@
+#pragma once
+
+// Rolling stream health metrics for the game and the receiver. Rates are summed over
+// the last two seconds, timings keep the last samples for percentiles. MetricsText
+// collects "name value" lines, MetricsFileWriter writes them on its own thread to a file
+// that scrapers can poll.
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "stream_log.h"
+
+namespace stream_stats {
+
+    // Amount per second over the last WINDOW_SECONDS, kept in 100 ms buckets
+    class RollingRate {
+        public:
+            static constexpr int BUCKETS = 20;
+            static constexpr double BUCKET_SECONDS = 0.1;
+            static constexpr double WINDOW_SECONDS = BUCKETS * BUCKET_SECONDS;
+
+            void Add(double amount, double now) {
+                Advance(now);
+                m_buckets[m_slot % BUCKETS] += amount;
+            }
+
+            double PerSecond(double now) {
+                Advance(now);
+                double sum = 0.0;
+                for (double bucket : m_buckets) sum += bucket;
+                return sum / WINDOW_SECONDS;
+            }
+
+        private:
+            // clears the buckets that fell out of the window since the last call
+            void Advance(double now) {
+                int64_t slot = static_cast<int64_t>(std::floor(now / BUCKET_SECONDS));
+                if (slot <= m_slot) return;
+                int64_t stale = std::min<int64_t>(slot - m_slot, BUCKETS);
+                for (int64_t i = 1; i <= stale; ++i) m_buckets[(m_slot + i) % BUCKETS] = 0.0;
+                m_slot = slot;
+            }
+
+            double m_buckets[BUCKETS] = {};
+            int64_t m_slot = 0;
+    };
+
+    // The last N values, e.g. encode or decode times in milliseconds
+    template<size_t N>
+    class RollingSamples {
+        public:
+            void Add(double value) {
+                m_values[m_next % N] = value;
+                m_next++;
+            }
+
+            double Percentile(double p) const {
+                size_t count = Count();
+                if (count == 0) return 0.0;
+                double sorted[N];
+                std::copy(m_values, m_values + count, sorted);
+                size_t index = std::min(count - 1, static_cast<size_t>(p * count));
+                std::nth_element(sorted, sorted + index, sorted + count);
+                return sorted[index];
+            }
+
+            size_t Count() const { return std::min<size_t>(m_next, N); }
+
+        private:
+            double m_values[N] = {};
+            size_t m_next = 0;
+    };
+
+    // Plain text, one "name value" pair per line
+    class MetricsText {
+        public:
+            void Add(const char* name, double value) {
+                char line[128];
+                snprintf(line, sizeof(line), "%s %.3f\n", name, value);
+                m_text += line;
+            }
+
+            const std::string& Text() const { return m_text; }
+            void Clear() { m_text.clear(); }
+            void Append(const MetricsText& other) { m_text += other.m_text; }
+
+            // Writes a temporary file and renames it, readers never see a half written file
+            bool WriteFile(const std::string& path) const {
+                std::string tmpPath = path + ".tmp";
+                FILE* file = fopen(tmpPath.c_str(), "w");
+                if (!file) return false;
+                fwrite(m_text.data(), 1, m_text.size(), file);
+                fclose(file);
+
+                std::error_code error;
+                std::filesystem::rename(tmpPath, path, error);
+                return !error;
+            }
+
+            void Swap(MetricsText& other) { m_text.swap(other.m_text); }
+
+        private:
+            std::string m_text;
+    };
+
+    // Writes MetricsText files on a background thread, so the frame loop never waits on
+    // the disk. Only the newest text is kept: one published while a write is running
+    // replaces any other that is still waiting.
+    class MetricsFileWriter {
+        public:
+            explicit MetricsFileWriter(std::string path)
+                : m_path(std::move(path)), m_thread(&MetricsFileWriter::Run, this) {}
+
+            // Writes the last published text before returning
+            ~MetricsFileWriter() {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_running = false;
+                }
+                m_condVar.notify_one();
+                if (m_thread.joinable()) m_thread.join();
+            }
+
+            // Copies the text, reusing the capacity of earlier ones
+            void Publish(const MetricsText& metrics) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending.Clear();
+                m_pending.Append(metrics);
+                m_hasPending = true;
+                m_condVar.notify_one();
+            }
+
+        private:
+            void Run() {
+                MetricsText writing;
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (true) {
+                    m_condVar.wait(lock, [this] { return m_hasPending || !m_running; });
+                    if (!m_hasPending) break;
+
+                    writing.Swap(m_pending);
+                    m_hasPending = false;
+                    lock.unlock();
+
+                    if (!writing.WriteFile(m_path)) LOG_WARN("Could not write %s", m_path.c_str());
+
+                    lock.lock();
+                }
+            }
+
+            std::string m_path;
+            std::mutex m_mutex;
+            std::condition_variable m_condVar;
+            MetricsText m_pending;
+            bool m_hasPending = false;
+            bool m_running = true;
+            std::thread m_thread; // last, starts after the members it uses
+    };
+
+} // namespace stream_stats
@@ -0,0 +1,144 @@
+#pragma once
+
+// Scoped timing for the streaming pipeline (game.cpp and receiver.cpp), exported as
+// Chrome trace JSON that chrome://tracing and Perfetto open directly.
+//
+// Build with -DSTREAM_TRACING to enable it; otherwise every macro compiles to nothing.
+// Each thread writes into its own ring buffer without locks; only the first event of
+// a thread takes a mutex to register the buffer. When a ring is full the oldest events
+// are overwritten. WriteChromeTrace reads the rings without synchronizing with their
+// writers, so call it at shutdown after every thread that traced has been joined.
+
+#ifdef STREAM_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define STREAM_TRACE_GETPID _getpid
+#else
+#include <unistd.h>
+#define STREAM_TRACE_GETPID getpid
+#endif
+
+namespace stream_trace {
+
+    struct Event {
+        const char* name; // string literal, never copied
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    struct ThreadBuffer {
+        static constexpr size_t CAPACITY = 1 << 16; // power of two
+
+        uint32_t tid = 0;
+        std::string name;
+        std::atomic<uint64_t> head{0};
+        std::unique_ptr<Event[]> events{new Event[CAPACITY]};
+    };
+
+    inline uint64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers; // kept after their thread exits
+    };
+
+    inline Registry& GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    inline ThreadBuffer& GetThreadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+            buffer = registry.buffers.back().get();
+            buffer->tid = static_cast<uint32_t>(registry.buffers.size());
+        }
+        return *buffer;
+    }
+
+    inline void Record(const char* name, uint64_t startNs, uint64_t endNs) {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head & (ThreadBuffer::CAPACITY - 1)] = { name, startNs, endNs - startNs };
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    inline void SetThreadName(const char* name) {
+        GetThreadBuffer().name = name;
+    }
+
+    class Scope {
+        public:
+            explicit Scope(const char* name) : m_name(name), m_start(NowNs()) {}
+            ~Scope() { Record(m_name, m_start, NowNs()); }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            const char* m_name;
+            uint64_t m_start;
+    };
+
+    // Timestamps are steady_clock, so traces of processes on the same host line up
+    inline bool WriteChromeTrace(const char* path, const char* processName) {
+        FILE* file = fopen(path, "w");
+        if (!file) return false;
+
+        int pid = STREAM_TRACE_GETPID();
+        fprintf(file, "{\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"%s\"}}", pid, processName);
+
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers) {
+            if (!buffer->name.empty()) {
+                fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        pid, buffer->tid, buffer->name.c_str());
+            }
+
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > ThreadBuffer::CAPACITY ? head - ThreadBuffer::CAPACITY : 0;
+            for (uint64_t i = first; i < head; ++i) {
+                const Event& event = buffer->events[i & (ThreadBuffer::CAPACITY - 1)];
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        event.name, pid, buffer->tid, event.startNs / 1000.0, event.durationNs / 1000.0);
+            }
+        }
+
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        return true;
+    }
+
+} // namespace stream_trace
+
+#define STREAM_TRACE_CONCAT_(a, b) a##b
+#define STREAM_TRACE_CONCAT(a, b) STREAM_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) ::stream_trace::Scope STREAM_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) ::stream_trace::SetThreadName(name)
+#define TRACE_WRITE(path, processName) ::stream_trace::WriteChromeTrace(path, processName)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_WRITE(path, processName) ((void)0)
+
+#endif
@@ -0,0 +1,198 @@
+#pragma once
+
+// Wire format of the video stream and the two ends of it: splitting an encoded frame
+// into datagrams (game, headless_sender) and putting it back together (receiver).
+// Nothing here touches a socket, so transport_bench.cpp can measure both ends.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+typedef struct RTHeader {
+    double time;
+    unsigned long packetnum;
+} RTHeader_t;
+
+#pragma pack(push, 1)
+typedef struct FragmentHeader {
+    uint32_t frame_id;
+    uint16_t total_fragments;
+    uint16_t fragment_index;
+} FragmentHeader_t;
+#pragma pack(pop)
+
+static constexpr int FRAGMENT_MTU = 1400;
+static constexpr int FRAGMENT_HEADER_SIZE = sizeof(RTHeader_t) + sizeof(FragmentHeader_t);
+static constexpr int FRAGMENT_MAX_PAYLOAD = FRAGMENT_MTU - FRAGMENT_HEADER_SIZE;
+
+// Calls emit(datagram, size) for every fragment of one frame, stops at the first
+// negative return value and passes it on. Returns the number of fragments otherwise.
+template<typename Emit>
+int FragmentFrame(const char* buffer, int len, uint32_t frameId, Emit emit) {
+    int totalFragments = (len + FRAGMENT_MAX_PAYLOAD - 1) / FRAGMENT_MAX_PAYLOAD;
+
+    for (int i = 0; i < totalFragments; ++i) {
+        int payloadSize = std::min(FRAGMENT_MAX_PAYLOAD, len - i * FRAGMENT_MAX_PAYLOAD);
+
+        char datagram[FRAGMENT_MTU];
+
+        RTHeader_t rtHeader;
+        auto now = std::chrono::steady_clock::now();
+        rtHeader.time = std::chrono::duration<double>(now.time_since_epoch()).count();
+        rtHeader.packetnum = frameId;
+
+        FragmentHeader_t fragHeader;
+        fragHeader.frame_id = frameId;
+        fragHeader.total_fragments = static_cast<uint16_t>(totalFragments);
+        fragHeader.fragment_index = static_cast<uint16_t>(i);
+
+        memcpy(datagram, &rtHeader, sizeof(rtHeader));
+        memcpy(datagram + sizeof(rtHeader), &fragHeader, sizeof(fragHeader));
+        memcpy(datagram + FRAGMENT_HEADER_SIZE, buffer + i * FRAGMENT_MAX_PAYLOAD, payloadSize);
+
+        int ret = emit(datagram, FRAGMENT_HEADER_SIZE + payloadSize);
+        if (ret < 0) return ret;
+    }
+
+    return totalFragments;
+}
+
+// Reads the fragment header of a datagram, false if it is too short to be one
+inline bool ParseFragment(const char* datagram, int size, FragmentHeader_t& header, const char*& payload, int& payloadSize) {
+    if (size < FRAGMENT_HEADER_SIZE) return false;
+    memcpy(&header, datagram + sizeof(RTHeader_t), sizeof(header));
+    payload = datagram + FRAGMENT_HEADER_SIZE;
+    payloadSize = size - FRAGMENT_HEADER_SIZE;
+    return true;
+}
+
+// A datagram with total_fragments 0 is not part of a frame but carries one small message
+// whole, fragment_index says which. It travels on the video socket, so it takes the
+// same path through netsim and packet logs as the frames it belongs to.
+static constexpr uint16_t MESSAGE_PLAYER_STATE = 1;
+
+inline bool IsMessage(const FragmentHeader_t& header) { return header.total_fragments == 0; }
+
+// Writes a message into `datagram` (FRAGMENT_MTU bytes), returns its size or -1 if the
+// payload does not fit into one datagram
+inline int BuildMessage(char* datagram, uint16_t type, uint32_t id, const void* payload, int size) {
+    if (size < 0 || size > FRAGMENT_MAX_PAYLOAD) return -1;
+
+    RTHeader_t rtHeader;
+    rtHeader.time = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    rtHeader.packetnum = id;
+
+    FragmentHeader_t fragHeader;
+    fragHeader.frame_id = id;
+    fragHeader.total_fragments = 0;
+    fragHeader.fragment_index = type;
+
+    memcpy(datagram, &rtHeader, sizeof(rtHeader));
+    memcpy(datagram + sizeof(rtHeader), &fragHeader, sizeof(fragHeader));
+    memcpy(datagram + FRAGMENT_HEADER_SIZE, payload, size);
+    return FRAGMENT_HEADER_SIZE + size;
+}
+
+// Collects fragments per frame id until a frame is complete. Fragments may arrive in
+// any order and more than once. Frame ids count up per stream: a frame that is still
+// incomplete when a frame MAX_FRAME_DISTANCE ids newer arrives is given up and counted
+// in GetEvictedFrames, so lost fragments cannot pile up.
+class FrameReassembler {
+    public:
+        static constexpr uint32_t MAX_FRAME_DISTANCE = 32;
+        // a jump back further than this is a restarted sender, not a late fragment
+        static constexpr uint32_t RESTART_DISTANCE = 1000;
+
+        // NewFrame: first fragment of a frame id. A one-fragment frame is Complete at once.
+        // Late: the frame was completed or given up already, the fragment is ignored.
+        enum class Result { Rejected, Late, Added, NewFrame, Complete };
+
+        // On Complete the frame is copied into `frame`, reusing its capacity, and forgotten
+        Result AddFragment(const FragmentHeader_t& header, const char* payload, int payloadSize, double arrival,
+                           std::vector<uint8_t>& frame, double& firstArrival) {
+            if (header.total_fragments == 0 || header.fragment_index >= header.total_fragments) return Result::Rejected;
+
+            int32_t distance = static_cast<int32_t>(header.frame_id - m_newestFrameId);
+            if (!m_started || distance > 0 || distance < -static_cast<int32_t>(RESTART_DISTANCE)) {
+                if (m_started && distance < 0) { // the sender restarted, what is pending is gone
+                    Clear();
+                    for (auto& slot : m_completed) slot.valid = false;
+                }
+                m_started = true;
+                m_newestFrameId = header.frame_id;
+                EvictOldFrames();
+            } else if (static_cast<uint32_t>(-distance) >= MAX_FRAME_DISTANCE) {
+                return Result::Late;
+            }
+            CompletedSlot& completed = m_completed[header.frame_id % COMPLETED_HISTORY];
+            if (completed.valid && completed.frameId == header.frame_id) return Result::Late;
+
+            auto& buffer = m_frames[header.frame_id];
+            bool newFrame = buffer.totalFragments == 0;
+            if (newFrame) {
+                buffer.totalFragments = header.total_fragments;
+                buffer.firstArrival = arrival;
+            }
+            if (header.total_fragments != buffer.totalFragments) return Result::Rejected;
+
+            auto& fragment = buffer.fragments[header.fragment_index];
+            buffer.totalSize += payloadSize - fragment.size(); // a duplicate replaces its copy
+            fragment.assign(payload, payload + payloadSize);
+
+            if (buffer.fragments.size() < buffer.totalFragments) return newFrame ? Result::NewFrame : Result::Added;
+
+            frame.clear();
+            frame.reserve(buffer.totalSize);
+            for (auto& [index, data] : buffer.fragments) frame.insert(frame.end(), data.begin(), data.end());
+            firstArrival = buffer.firstArrival;
+            m_frames.erase(header.frame_id);
+            completed = { header.frame_id, true };
+            return Result::Complete;
+        }
+
+        size_t GetPendingFrames() const { return m_frames.size(); }
+        uint64_t GetEvictedFrames() const { return m_evictedFrames; }
+
+        // Gives up every pending frame, they count as evicted
+        void Clear() {
+            m_evictedFrames += m_frames.size();
+            m_frames.clear();
+        }
+
+    private:
+        static constexpr uint32_t COMPLETED_HISTORY = 2 * MAX_FRAME_DISTANCE;
+
+        struct FrameBuffer {
+            uint16_t totalFragments = 0;
+            std::map<uint16_t, std::vector<uint8_t>> fragments; // ordered by index
+            size_t totalSize = 0;
+            double firstArrival = 0.0;
+        };
+
+        // remembers completed frames, so a duplicate fragment does not start them again
+        struct CompletedSlot {
+            uint32_t frameId = 0;
+            bool valid = false;
+        };
+
+        void EvictOldFrames() {
+            for (auto it = m_frames.begin(); it != m_frames.end();) {
+                if (m_newestFrameId - it->first >= MAX_FRAME_DISTANCE) {
+                    it = m_frames.erase(it);
+                    m_evictedFrames++;
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::unordered_map<uint32_t, FrameBuffer> m_frames;
+        CompletedSlot m_completed[COMPLETED_HISTORY];
+        bool m_started = false;
+        uint32_t m_newestFrameId = 0;
+        uint64_t m_evictedFrames = 0;
+};
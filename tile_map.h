@@ -0,0 +1,126 @@
+#pragma once
+
+// Binary tile maps: a TileMapHeader and one byte per tile (a CollisionGrid::Tile),
+// stored chunk by chunk so the tiles of one chunk are contiguous. The file is memory
+// mapped, opening a map reads nothing but the header; map_convert.cpp writes them from
+// the text maps.
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "collision_grid.h"
+
+#pragma pack(push, 1)
+struct TileMapHeader {
+    char     magic[8]; // "TILEMAP"
+    uint32_t version;
+    int32_t  columns;
+    int32_t  rows;
+    int32_t  chunkSize;  // tiles per chunk side, edge chunks are padded with void
+    int32_t  originCol;  // the tile at world (0, 0)
+    int32_t  originRow;
+};
+#pragma pack(pop)
+
+static constexpr char TILE_MAP_MAGIC[8] = "TILEMAP";
+static constexpr uint32_t TILE_MAP_VERSION = 1;
+
+// Reads a text map, '#' is a wall and every other character floor
+inline bool LoadTextMap(const std::string& path, std::vector<std::string>& rows) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    rows.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        rows.push_back(line);
+    }
+    return true;
+}
+
+class TileMapView {
+    public:
+        bool Open(const std::string& path) {
+            if (!m_file.openRead(path) || m_file.getSize() < sizeof(TileMapHeader)) return false;
+            memcpy(&m_header, m_file.data(), sizeof(m_header));
+            if (memcmp(m_header.magic, TILE_MAP_MAGIC, sizeof(m_header.magic)) != 0 || m_header.version != TILE_MAP_VERSION) return false;
+            if (m_header.columns < 0 || m_header.rows < 0 || m_header.chunkSize <= 0) return false;
+            return m_file.getSize() >= sizeof(TileMapHeader) + DataSize(m_header);
+        }
+
+        CollisionGrid::Tile At(int col, int row) const {
+            if (col < 0 || row < 0 || col >= m_header.columns || row >= m_header.rows) return CollisionGrid::Tile::Void;
+            return static_cast<CollisionGrid::Tile>(m_file.data()[sizeof(TileMapHeader) + TileOffset(m_header, col, row)]);
+        }
+
+        const TileMapHeader& GetHeader() const { return m_header; }
+
+        // Byte of tile (col, row) after the header
+        static size_t TileOffset(const TileMapHeader& header, int col, int row) {
+            int chunkColumns = (header.columns + header.chunkSize - 1) / header.chunkSize;
+            size_t chunk = size_t(row / header.chunkSize) * chunkColumns + col / header.chunkSize;
+            return (chunk * header.chunkSize + row % header.chunkSize) * header.chunkSize + col % header.chunkSize;
+        }
+
+        static size_t DataSize(const TileMapHeader& header) {
+            size_t chunkColumns = (header.columns + header.chunkSize - 1) / header.chunkSize;
+            size_t chunkRows = (header.rows + header.chunkSize - 1) / header.chunkSize;
+            return chunkColumns * chunkRows * header.chunkSize * header.chunkSize;
+        }
+
+    private:
+        MappedFile m_file;
+        TileMapHeader m_header{};
+};
+
+// tileAt(col, row) gives the tiles of a columns x rows map
+template<typename TileAt>
+bool WriteTileMap(const std::string& path, int columns, int rows, int chunkSize, int originCol, int originRow, TileAt tileAt) {
+    if (columns < 0 || rows < 0 || chunkSize <= 0) return false;
+    TileMapHeader header{};
+    memcpy(header.magic, TILE_MAP_MAGIC, sizeof(header.magic));
+    header.version = TILE_MAP_VERSION;
+    header.columns = columns;
+    header.rows = rows;
+    header.chunkSize = chunkSize;
+    header.originCol = originCol;
+    header.originRow = originRow;
+
+    MappedFile file;
+    if (!file.create(path, sizeof(header) + TileMapView::DataSize(header))) return false;
+    memcpy(file.data(), &header, sizeof(header));
+    uint8_t* tiles = file.data() + sizeof(header);
+    memset(tiles, static_cast<uint8_t>(CollisionGrid::Tile::Void), TileMapView::DataSize(header));
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < columns; ++col) {
+            tiles[TileMapView::TileOffset(header, col, row)] = static_cast<uint8_t>(tileAt(col, row));
+        }
+    }
+    file.close(sizeof(header) + TileMapView::DataSize(header));
+    return true;
+}
+
+// Builds the collision grid of a text map or a .tmap, as the game places them. chunkSize
+// is the map's, 32 for text maps.
+inline bool LoadMapGrid(const std::string& path, CollisionGrid& grid, int& chunkSize) {
+    bool binary = path.size() > 5 && path.compare(path.size() - 5, 5, ".tmap") == 0;
+    if (binary) {
+        TileMapView map;
+        if (!map.Open(path)) return false;
+        const TileMapHeader& header = map.GetHeader();
+        grid.Build(header.columns, header.rows, [&](int col, int row) { return map.At(col, row); },
+                   header.originCol, header.originRow, 1.0f);
+        chunkSize = header.chunkSize;
+        return true;
+    }
+
+    std::vector<std::string> rows;
+    if (!LoadTextMap(path, rows)) return false;
+    grid.Build(rows);
+    chunkSize = 32;
+    return true;
+}
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "stream_transport.h"
+
+// Microbenchmarks for the video transport: fragmenting an encoded frame into datagrams
+// and reassembling it on the receiver, for frame sizes from a small P-frame to a large
+// keyframe and for fragments arriving in order, reversed, shuffled or with 1% lost.
+// Needs nothing but the standard library, so it builds and runs anywhere:
+//
+//   g++ -std=c++17 -O2 transport_bench.cpp -o transport_bench
+//
+// Each benchmark repeats until it ran for --min-time seconds and reports the time and
+// heap allocations per frame. Allocations are counted by replacing the global operator
+// new, which is why this has to stay its own program.
+
+static uint64_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// xorshift64*, the same orders on every platform
+class BenchRandom {
+public:
+    explicit BenchRandom(uint64_t seed) : state(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t state;
+};
+
+enum class ArrivalPattern { InOrder, Reversed, Shuffled, Loss };
+
+const char* patternName(ArrivalPattern pattern) {
+    switch (pattern) {
+        case ArrivalPattern::InOrder:  return "in_order";
+        case ArrivalPattern::Reversed: return "reversed";
+        case ArrivalPattern::Shuffled: return "shuffled";
+        case ArrivalPattern::Loss:     return "loss_1pct";
+    }
+    return "?";
+}
+
+// Fragment indices in arrival order. Shuffle and loss vary per frame, so a benchmark
+// cycles through ORDER_VARIANTS of them.
+static constexpr int ORDER_VARIANTS = 64;
+static constexpr double LOSS_RATE = 0.01;
+
+std::vector<std::vector<int>> makeOrders(ArrivalPattern pattern, int fragments, uint64_t seed) {
+    BenchRandom random(seed);
+    std::vector<std::vector<int>> orders(ORDER_VARIANTS);
+    for (auto& order : orders) {
+        for (int i = 0; i < fragments; ++i) {
+            if (pattern == ArrivalPattern::Loss && random.uniform() < LOSS_RATE) continue;
+            order.push_back(i);
+        }
+        if (pattern == ArrivalPattern::Reversed) std::reverse(order.begin(), order.end());
+        if (pattern == ArrivalPattern::Shuffled) {
+            for (int i = (int)order.size() - 1; i > 0; --i) std::swap(order[i], order[random.next() % (i + 1)]);
+        }
+    }
+    return orders;
+}
+
+// A stand-in for an encoded frame, incompressible like a real bitstream
+std::vector<char> makeFrame(int size, uint64_t seed) {
+    BenchRandom random(seed);
+    std::vector<char> frame(size);
+    for (auto& byte : frame) byte = static_cast<char>(random.next() >> 56);
+    return frame;
+}
+
+// Datagrams of one frame as the sender puts them on the wire
+std::vector<std::vector<char>> fragmentOnce(const std::vector<char>& frame) {
+    std::vector<std::vector<char>> datagrams;
+    FragmentFrame(frame.data(), (int)frame.size(), 1, [&](const char* datagram, int size) {
+        datagrams.emplace_back(datagram, datagram + size);
+        return size;
+    });
+    return datagrams;
+}
+
+struct BenchResult {
+    uint64_t frames = 0;
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+    uint64_t completed = 0;
+    size_t maxPending = 0; // incomplete frames the reassembler held at once
+};
+
+// Runs `frame` in growing batches until a batch takes minTime; the last batch is reported
+BenchResult runTimed(double minTime, const std::function<bool()>& frame) {
+    BenchResult result;
+    for (uint64_t batch = 1;; batch *= 4) {
+        result = BenchResult();
+        uint64_t allocationsBefore = allocationCount;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (frame()) result.completed++;
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.allocations = allocationCount - allocationsBefore;
+        result.frames = batch;
+        if (result.seconds >= minTime || batch >= (1ull << 40)) return result;
+    }
+}
+
+void printHeader() {
+    printf("%-36s %12s %10s %13s %10s %10s %8s\n", "benchmark", "ns/frame", "MB/s", "allocs/frame", "complete", "frames", "pending");
+}
+
+void printResult(const std::string& name, int frameSize, const BenchResult& result) {
+    double nsPerFrame = result.seconds * 1e9 / result.frames;
+    double megabytesPerSecond = double(frameSize) * result.frames / result.seconds / 1e6;
+    printf("%-36s %12.0f %10.1f %13.2f %9.1f%% %10llu %8zu\n", name.c_str(), nsPerFrame, megabytesPerSecond,
+           double(result.allocations) / result.frames, 100.0 * result.completed / result.frames,
+           (unsigned long long)result.frames, result.maxPending);
+}
+
+// Fragmenting into a preallocated datagram buffer, as UDPsend does before sendto
+BenchResult benchFragment(const std::vector<char>& frame, double minTime) {
+    char wire[FRAGMENT_MTU];
+    uint32_t frameId = 0;
+    return runTimed(minTime, [&]() {
+        int fragments = FragmentFrame(frame.data(), (int)frame.size(), ++frameId, [&](const char* datagram, int size) {
+            memcpy(wire, datagram, size);
+            return size;
+        });
+        return fragments > 0;
+    });
+}
+
+// Feeding one frame's datagrams through parsing and reassembly in the given orders
+BenchResult benchReassemble(const std::vector<char>& frame, ArrivalPattern pattern, double minTime) {
+    auto datagrams = fragmentOnce(frame);
+    auto orders = makeOrders(pattern, (int)datagrams.size(), 0x5EED + frame.size());
+    FrameReassembler reassembler;
+    std::vector<uint8_t> fullFrame;
+    uint32_t frameId = 0;
+    size_t maxPending = 0;
+
+    // incomplete frames are evicted by the reassembler, the pending count stays bounded
+    BenchResult result = runTimed(minTime, [&]() {
+        auto& order = orders[frameId % ORDER_VARIANTS];
+        ++frameId;
+        bool complete = false;
+        for (int index : order) {
+            FragmentHeader_t header;
+            const char* payload;
+            int payloadSize;
+            if (!ParseFragment(datagrams[index].data(), (int)datagrams[index].size(), header, payload, payloadSize)) continue;
+            header.frame_id = frameId;
+            double firstArrival;
+            auto added = reassembler.AddFragment(header, payload, payloadSize, 0.0, fullFrame, firstArrival);
+            if (added == FrameReassembler::Result::Complete) complete = fullFrame.size() == frame.size();
+        }
+        maxPending = std::max(maxPending, reassembler.GetPendingFrames());
+        return complete;
+    });
+    result.maxPending = maxPending;
+    return result;
+}
+
+// Both ends back to back, in order: the transport's cost per frame without the network
+BenchResult benchRoundTrip(const std::vector<char>& frame, double minTime) {
+    FrameReassembler reassembler;
+    std::vector<uint8_t> fullFrame;
+    uint32_t frameId = 0;
+
+    return runTimed(minTime, [&]() {
+        bool complete = false;
+        FragmentFrame(frame.data(), (int)frame.size(), ++frameId, [&](const char* datagram, int size) {
+            FragmentHeader_t header;
+            const char* payload;
+            int payloadSize;
+            if (!ParseFragment(datagram, size, header, payload, payloadSize)) return -1;
+            double firstArrival;
+            auto added = reassembler.AddFragment(header, payload, payloadSize, 0.0, fullFrame, firstArrival);
+            if (added == FrameReassembler::Result::Complete) complete = fullFrame.size() == frame.size();
+            return size;
+        });
+        return complete;
+    });
+}
+
+void printUsage() {
+    std::cerr << "usage: transport_bench [--filter TEXT] [--min-time SECONDS]\n"
+                 "  --filter TEXT     only benchmarks whose name contains TEXT\n"
+                 "  --min-time S      run time of each benchmark (0.5)\n";
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() { return ++i < argc ? argv[i] : "0"; };
+
+        if (arg == "--filter") {
+            filter = next();
+        } else if (arg == "--min-time") {
+            minTime = atof(next());
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    const int frameSizes[] = { 1 << 10, 16 << 10, 64 << 10, 256 << 10 };
+    const ArrivalPattern patterns[] = { ArrivalPattern::InOrder, ArrivalPattern::Reversed, ArrivalPattern::Shuffled, ArrivalPattern::Loss };
+
+    printf("fragment payload %d bytes, %d byte header\n", FRAGMENT_MAX_PAYLOAD, FRAGMENT_HEADER_SIZE);
+    printHeader();
+
+    auto selected = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    for (int size : frameSizes) {
+        auto frame = makeFrame(size, size);
+        std::string sizeName = std::to_string(size >> 10) + "K";
+
+        std::string name = "fragment/" + sizeName;
+        if (selected(name)) printResult(name, size, benchFragment(frame, minTime));
+
+        for (ArrivalPattern pattern : patterns) {
+            name = "reassemble/" + sizeName + "/" + patternName(pattern);
+            if (selected(name)) printResult(name, size, benchReassemble(frame, pattern, minTime));
+        }
+
+        name = "round_trip/" + sizeName;
+        if (selected(name)) printResult(name, size, benchRoundTrip(frame, minTime));
+    }
+    return 0;
+}